@@ -0,0 +1,55 @@
+#!/bin/sh
+# Writes a configuration with many virtual hosts, for timing the config
+# loader: ./scripts/gen_bench_config.sh 5000 > config/bench.conf
+#                 ./webserv -t config/bench.conf
+
+COUNT=${1:-5000}
+PORTS=${2:-4}
+
+echo "# $COUNT virtual hosts on $PORTS ports, generated by $0"
+echo "include valid/mime.types"
+echo
+
+i=0
+while [ "$i" -lt "$COUNT" ]; do
+	port=$((8000 + i % PORTS))
+	cat <<BLOCK
+server {
+	listen $port
+	server_name vhost$i.example.com www.vhost$i.example.com
+	root ./pages
+	index index.html index.htm
+	error_page 404 /404.html
+	client_max_body_size 1000000
+	rewrite ^/old/(.*)\$ /new/\$1 permanent
+
+	location / {
+		allow_methods GET POST
+		autoindex off
+	}
+
+	location = /health {
+		allow_methods GET
+		return 302 /
+	}
+
+	location ^~ /static/ {
+		root ./assets
+		allow_methods GET
+		autoindex on
+	}
+
+	location ~ \.php\$ {
+		cgi .php /usr/bin/php-cgi
+		allow_methods GET POST
+	}
+
+	location /upload {
+		root ./uploads
+		allow_methods POST DELETE
+	}
+}
+
+BLOCK
+	i=$((i + 1))
+done
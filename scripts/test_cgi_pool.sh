@@ -0,0 +1,80 @@
+#!/bin/sh
+# Sends real requests through a "cgi_pool" location and checks that they are
+# all answered by the pre-spawned workers, without a fork per request.
+# Uses php-cgi when it is installed (or PHP_CGI), else test_cgi/fcgi_worker.py:
+#                 make && ./scripts/test_cgi_pool.sh
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WEBSERV=${WEBSERV:-$ROOT/webserv}
+PORT=${PORT:-8471}
+WORKERS=2
+INTERPRETER=${PHP_CGI:-$(command -v php-cgi || echo "$ROOT/test_cgi/fcgi_worker.py")}
+
+DIR=$(mktemp -d)
+PID=
+cleanup() {
+	# SIGINT, so webserv stops its workers on the way out
+	[ -n "$PID" ] && kill -INT "$PID" 2>/dev/null && wait "$PID" 2>/dev/null
+	rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+fail() {
+	echo "FAIL: $1"
+	[ -f "$DIR/webserv.log" ] && grep -a -v "onnect" "$DIR/webserv.log" | tail -20
+	exit 1
+}
+
+mkdir "$DIR/cgi"
+printf '<?php echo "pid=" . getmypid() . "\\n"; ?>\n' > "$DIR/cgi/pid.php"
+chmod +x "$DIR/cgi/pid.php"
+cat > "$DIR/pool.conf" <<CONF
+server {
+	listen $PORT
+	root $DIR
+	location /cgi {
+		root $DIR/cgi
+		cgi .php $INTERPRETER
+		cgi_pool $WORKERS
+		allow_methods GET POST
+	}
+}
+CONF
+
+"$WEBSERV" "$DIR/pool.conf" > "$DIR/webserv.log" 2>&1 &
+PID=$!
+sleep 1
+kill -0 "$PID" 2>/dev/null || fail "webserv did not start"
+
+request() {
+	curl -s -o "$DIR/out.$1" -w "%{http_code}" "http://127.0.0.1:$PORT/cgi/pid.php" > "$DIR/code.$1"
+}
+
+# One after another, then all at once so some have to queue for a worker
+i=0
+while [ $i -lt 10 ]; do
+	request $i
+	i=$((i + 1))
+done
+JOBS=
+while [ $i -lt 30 ]; do
+	request $i &
+	JOBS="$JOBS $!"
+	i=$((i + 1))
+done
+wait $JOBS
+
+i=0
+while [ $i -lt 30 ]; do
+	[ "$(cat "$DIR/code.$i" 2>/dev/null)" = "200" ] || fail "request $i got $(cat "$DIR/code.$i" 2>/dev/null)"
+	grep -q '^pid=[0-9]' "$DIR/out.$i" || fail "request $i: $(cat "$DIR/out.$i")"
+	i=$((i + 1))
+done
+
+PIDS=$(cat "$DIR"/out.* | grep '^pid=' | sort -u | wc -l)
+[ "$PIDS" -le "$WORKERS" ] || fail "$PIDS different processes answered, pool has $WORKERS"
+
+BODY=$(curl -s -X POST --data-binary "0123456789" "http://127.0.0.1:$PORT/cgi/pid.php")
+echo "$BODY" | grep -q '^pid=[0-9]' || fail "POST: $BODY"
+
+echo "OK: 31 requests served by $PIDS pooled worker(s) of $INTERPRETER"
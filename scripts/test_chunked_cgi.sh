@@ -0,0 +1,93 @@
+#!/bin/sh
+# Sends a chunked POST to a CGI script followed by a GET on the same
+# connection, both pipelined and one after the other, and checks that the
+# script runs once and each request gets exactly one response.
+#                 make && ./scripts/test_chunked_cgi.sh
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WEBSERV=${WEBSERV:-$ROOT/webserv}
+PORT=${PORT:-8473}
+
+DIR=$(mktemp -d)
+PID=
+cleanup() {
+	[ -n "$PID" ] && kill -INT "$PID" 2>/dev/null && wait "$PID" 2>/dev/null
+	rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+fail() {
+	echo "FAIL: $1"
+	[ -f "$DIR/webserv.log" ] && grep -a -v "onnect" "$DIR/webserv.log" | tail -20
+	exit 1
+}
+
+mkdir "$DIR/cgi"
+echo static > "$DIR/index.html"
+cat > "$DIR/cgi/count.php" <<SCRIPT
+cat > /dev/null
+echo run >> "$DIR/runs"
+printf 'Content-Type: text/plain\r\n\r\nran\n'
+SCRIPT
+chmod +x "$DIR/cgi/count.php"
+cat > "$DIR/chunked.conf" <<CONF
+server {
+	listen $PORT
+	root $DIR
+	index index.html
+	location / {
+		allow_methods GET
+	}
+	location /cgi {
+		root $DIR/cgi
+		cgi .php /bin/sh
+		allow_methods GET POST
+	}
+}
+CONF
+
+"$WEBSERV" "$DIR/chunked.conf" > "$DIR/webserv.log" 2>&1 &
+PID=$!
+sleep 1
+kill -0 "$PID" 2>/dev/null || fail "webserv did not start"
+
+# Prints the number of responses received for each mode
+RESULT=$(python3 - "$PORT" <<'PY'
+import socket, sys, time
+
+port = int(sys.argv[1])
+post = (b"POST /cgi/count.php HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n"
+        b"5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n")
+get = b"GET /index.html HTTP/1.1\r\nHost: x\r\n\r\n"
+
+def responses(sock, wait):
+    sock.settimeout(wait)
+    data = b""
+    try:
+        while True:
+            chunk = sock.recv(65536)
+            if not chunk:
+                break
+            data += chunk
+    except socket.timeout:
+        pass
+    return data.count(b"HTTP/1.1 ")
+
+pipelined = socket.create_connection(("127.0.0.1", port))
+pipelined.sendall(post + get)
+first = responses(pipelined, 2)
+
+keepalive = socket.create_connection(("127.0.0.1", port))
+keepalive.sendall(post)
+second = responses(keepalive, 1)
+keepalive.sendall(get)
+second += responses(keepalive, 1)
+print(first, second)
+PY
+)
+
+[ "$RESULT" = "2 2" ] || fail "expected 2 responses per connection, got $RESULT"
+RUNS=$(wc -l < "$DIR/runs")
+[ "$RUNS" -eq 2 ] || fail "the script ran $RUNS times for 2 POSTs"
+
+echo "OK: chunked CGI POSTs ran once each, one response per request"
@@ -0,0 +1,249 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiCache.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 17:36:10 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 17:36:10 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiCache.hpp"
+#include "CgiHandler.hpp"
+#include "../utils/Metrics.hpp"
+
+std::map<const LocationConfig *, CgiCache::Cache> CgiCache::_caches;
+
+static std::string toLower(const std::string &value)
+{
+	std::string lower(value);
+	for (size_t i = 0; i < lower.size(); ++i)
+		lower[i] = std::tolower(static_cast<unsigned char>(lower[i]));
+	return lower;
+}
+
+// Header names are stored as the peer spelled them
+static const std::string *findHeader(const std::map<std::string, std::string> &headers,
+									const std::string &lowerName)
+{
+	for (std::map<std::string, std::string>::const_iterator it = headers.begin();
+		it != headers.end(); ++it) {
+		if (toLower(it->first) == lowerName)
+			return &it->second;
+	}
+	return NULL;
+}
+
+std::string CgiCache::keyFor(const LocationConfig &location, const Request &request)
+{
+	if (location.getCgiCacheTtl() == 0 || request.getReqMethod() != "GET")
+		return "";
+
+	const std::map<std::string, std::string> &headers = request.getReqHeaders();
+	if (findHeader(headers, "authorization"))
+		return "";
+
+	const std::string &keyTemplate = location.getCgiCacheKey();
+	std::string key;
+	size_t pos = 0;
+
+	// Variables were validated when the configuration was loaded
+	while (pos < keyTemplate.size()) {
+		size_t dollar = keyTemplate.find('$', pos);
+		key.append(keyTemplate, pos, dollar - pos);
+		if (dollar == std::string::npos)
+			break;
+
+		size_t end = keyTemplate.find_first_not_of(
+			"abcdefghijklmnopqrstuvwxyz0123456789_", dollar + 1);
+		if (end == std::string::npos)
+			end = keyTemplate.size();
+		std::string name = keyTemplate.substr(dollar + 1, end - dollar - 1);
+
+		if (name == "method")
+			key += request.getReqMethod();
+		else if (name == "host") {
+			const std::string *host = findHeader(headers, "host");
+			if (host)
+				key += toLower(*host);
+		} else if (name == "path")
+			key += request.getReqPath();
+		else if (name == "query")
+			key += request.getReqQueryString();
+		else {
+			std::string header = name.substr(5);
+			std::replace(header.begin(), header.end(), '_', '-');
+			const std::string *value = findHeader(headers, header);
+			if (value)
+				key += *value;
+		}
+		pos = end;
+	}
+	return key;
+}
+
+bool CgiCache::lookup(const LocationConfig &location, const std::string &key,
+					Response &response)
+{
+	const std::string &name = location.getPath();
+	Cache &cache = _caches[&location];
+	std::map<std::string, std::list<Entry>::iterator>::iterator it = cache.index.find(key);
+
+	if (it != cache.index.end() && it->second->expires <= Metrics::now()) {
+		_erase(location, cache, it->second);
+		it = cache.index.end();
+	}
+	if (it == cache.index.end()) {
+		Metrics::increment(Metrics::label("cgi_cache_misses_total", "location", name));
+		return false;
+	}
+
+	cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+	response = it->second->response;
+	Metrics::increment(Metrics::label("cgi_cache_hits_total", "location", name));
+	return true;
+}
+
+bool CgiCache::store(const LocationConfig &location, const std::string &key,
+					const Response &response)
+{
+	double lifetime = _lifetime(location, response);
+	if (lifetime <= 0)
+		return false;
+
+	// Key and body dominate; headers are counted at their rendered size
+	size_t size = key.size() + response.toString().size();
+	if (size > location.getCgiCacheMaxSize())
+		return false;
+
+	Cache &cache = _caches[&location];
+	std::map<std::string, std::list<Entry>::iterator>::iterator it = cache.index.find(key);
+	if (it != cache.index.end())
+		_erase(location, cache, it->second);
+
+	while (!cache.lru.empty() && cache.bytes + size > location.getCgiCacheMaxSize())
+		_erase(location, cache, --cache.lru.end());
+
+	Entry entry;
+	entry.key = key;
+	entry.response = response;
+	entry.expires = Metrics::now() + lifetime;
+	entry.size = size;
+	cache.lru.push_front(entry);
+	cache.index[key] = cache.lru.begin();
+	cache.bytes += size;
+	_updateGauges(location, cache);
+	return true;
+}
+
+bool CgiCache::join(const LocationConfig &location, const std::string &key,
+					CgiHandler *handler)
+{
+	Cache &cache = _caches[&location];
+	std::map<std::string, std::vector<CgiHandler *> >::iterator it = cache.inFlight.find(key);
+
+	if (it == cache.inFlight.end()) {
+		cache.inFlight[key];
+		return false;
+	}
+	it->second.push_back(handler);
+	return true;
+}
+
+void CgiCache::release(const LocationConfig &location, const std::string &key,
+					const Response *response)
+{
+	std::map<const LocationConfig *, Cache>::iterator cache = _caches.find(&location);
+	if (cache == _caches.end())
+		return;
+	std::map<std::string, std::vector<CgiHandler *> >::iterator it = cache->second.inFlight.find(key);
+	if (it == cache->second.inFlight.end())
+		return;
+
+	// Detached first: waiters that run by themselves must not find it
+	std::vector<CgiHandler *> waiters;
+	waiters.swap(it->second);
+	cache->second.inFlight.erase(it);
+
+	if (response && !waiters.empty())
+		Metrics::increment(Metrics::label("cgi_cache_collapsed_total", "location",
+			location.getPath()), waiters.size());
+	for (size_t i = 0; i < waiters.size(); ++i) {
+		if (response)
+			waiters[i]->deliver(*response);
+		else
+			waiters[i]->runAlone();
+	}
+}
+
+void CgiCache::leave(const LocationConfig &location, const std::string &key,
+					CgiHandler *handler)
+{
+	std::map<const LocationConfig *, Cache>::iterator cache = _caches.find(&location);
+	if (cache == _caches.end())
+		return;
+	std::map<std::string, std::vector<CgiHandler *> >::iterator it = cache->second.inFlight.find(key);
+	if (it == cache->second.inFlight.end())
+		return;
+
+	std::vector<CgiHandler *> &waiters = it->second;
+	waiters.erase(std::remove(waiters.begin(), waiters.end(), handler), waiters.end());
+}
+
+// Dropped before the clients are, so destroying them does not start their
+// waiters on the way out
+void CgiCache::forget(const LocationConfig &location)
+{
+	_caches.erase(&location);
+}
+
+void CgiCache::cleanup()
+{
+	_caches.clear();
+}
+
+// Seconds `response` may be served from the cache, 0 when it may not be
+// stored at all. The script's Cache-Control takes precedence over the TTL.
+double CgiCache::_lifetime(const LocationConfig &location, const Response &response)
+{
+	int code = response.getStatusCode();
+	if (code != 200 && code != 301 && code != 302)
+		return 0;
+
+	const std::map<std::string, std::string> &headers = response.getHeaders();
+	if (findHeader(headers, "set-cookie"))
+		return 0;
+
+	const std::string *cacheControl = findHeader(headers, "cache-control");
+	if (!cacheControl)
+		return location.getCgiCacheTtl();
+
+	std::string directives = toLower(*cacheControl);
+	if (directives.find("no-store") != std::string::npos
+		|| directives.find("no-cache") != std::string::npos
+		|| directives.find("private") != std::string::npos)
+		return 0;
+
+	size_t maxAge = directives.find("max-age=");
+	if (maxAge != std::string::npos)
+		return std::strtol(directives.c_str() + maxAge + 8, NULL, 10);
+	return location.getCgiCacheTtl();
+}
+
+void CgiCache::_erase(const LocationConfig &location, Cache &cache,
+					std::list<Entry>::iterator entry)
+{
+	cache.bytes -= entry->size;
+	cache.index.erase(entry->key);
+	cache.lru.erase(entry);
+	_updateGauges(location, cache);
+}
+
+void CgiCache::_updateGauges(const LocationConfig &location, const Cache &cache)
+{
+	const std::string &name = location.getPath();
+	Metrics::setGauge(Metrics::label("cgi_cache_bytes", "location", name), cache.bytes);
+	Metrics::setGauge(Metrics::label("cgi_cache_entries", "location", name), cache.index.size());
+}
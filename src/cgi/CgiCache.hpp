@@ -0,0 +1,87 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiCache.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 17:36:10 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 17:36:10 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../config/LocationConfig.hpp"
+#include "../http/Request.hpp"
+#include "../http/Response.hpp"
+#include <list>
+
+class CgiHandler;
+
+// Short-lived copies of CGI responses for locations with "cgi_cache". Each
+// location has its own LRU, bounded by "cgi_cache_max_size" bytes; entries
+// live for the configured TTL unless the script's Cache-Control says
+// otherwise. Identical requests that miss while one of them is already
+// running wait for its response instead of running the script again.
+class CgiCache
+{
+	public:
+		// The request's key under the location's cgi_cache_key, or an empty
+		// string when the request must not be served from the cache
+		static std::string keyFor(const LocationConfig &location, const Request &request);
+
+		static bool lookup(const LocationConfig &location, const std::string &key,
+						Response &response);
+		// Keeps `response` if its status and headers allow it
+		static bool store(const LocationConfig &location, const std::string &key,
+						const Response &response);
+
+		// Returns true when a request with `key` is already running, in which
+		// case `handler` waits for it. Otherwise `handler` becomes the one
+		// the next identical requests wait for.
+		static bool join(const LocationConfig &location, const std::string &key,
+						CgiHandler *handler);
+		// Ends the running request for `key`. Its waiters get `response`, or
+		// run by themselves when it is NULL.
+		static void release(const LocationConfig &location, const std::string &key,
+							const Response *response);
+		// Drops a waiter whose client went away
+		static void leave(const LocationConfig &location, const std::string &key,
+						CgiHandler *handler);
+
+		// Drops the cache of a location whose configuration is unloaded
+		static void forget(const LocationConfig &location);
+		static void cleanup();
+
+	private:
+		struct Entry
+		{
+			std::string key;
+			Response response;
+			double expires;
+			size_t size;
+		};
+
+		struct Cache
+		{
+			// Most recently used first
+			std::list<Entry> lru;
+			std::map<std::string, std::list<Entry>::iterator> index;
+			size_t bytes;
+			// Keys being computed, with the requests waiting for them
+			std::map<std::string, std::vector<CgiHandler *> > inFlight;
+
+			Cache() : bytes(0) {}
+		};
+
+		static std::map<const LocationConfig *, Cache> _caches;
+
+		static double _lifetime(const LocationConfig &location, const Response &response);
+		static void _erase(const LocationConfig &location, Cache &cache,
+						std::list<Entry>::iterator entry);
+		static void _updateGauges(const LocationConfig &location, const Cache &cache);
+
+		CgiCache();
+};
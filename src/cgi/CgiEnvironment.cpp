@@ -0,0 +1,68 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiEnvironment.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 16:05:48 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 16:05:48 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiEnvironment.hpp"
+#include "FastCgi.hpp"
+
+CgiEnvironment::CgiEnvironment() {}
+
+void CgiEnvironment::assign(const std::string &locationTemplate)
+{
+	// Headers and paths rarely add more than this; one allocation up front
+	_arena.reserve(locationTemplate.size() + 1024);
+	_arena = locationTemplate;
+}
+
+void CgiEnvironment::add(const std::string &name, const std::string &value)
+{
+	_arena += name;
+	_arena += '=';
+	_arena += value;
+	_arena += '\0';
+}
+
+void CgiEnvironment::addHeader(const std::string &header, const std::string &value)
+{
+	_arena += "HTTP_";
+	for (size_t i = 0; i < header.size(); ++i) {
+		char c = header[i];
+		_arena += (c == '-') ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+	}
+	_arena += '=';
+	_arena += value;
+	_arena += '\0';
+}
+
+char **CgiEnvironment::envp()
+{
+	_pointers.clear();
+	for (size_t pos = 0; pos < _arena.size(); pos = _arena.find('\0', pos) + 1)
+		_pointers.push_back(&_arena[pos]);
+	_pointers.push_back(NULL);
+	return &_pointers[0];
+}
+
+void CgiEnvironment::appendFastCgiParams(std::string &params) const
+{
+	const char *arena = _arena.data();
+	size_t pos = 0;
+
+	while (pos < _arena.size()) {
+		size_t end = _arena.find('\0', pos);
+		size_t equals = _arena.find('=', pos);
+		if (equals == std::string::npos || equals > end)
+			equals = end;
+		FastCgi::appendParam(params, arena + pos, equals - pos,
+			arena + std::min(equals + 1, end), end - std::min(equals + 1, end));
+		pos = end + 1;
+	}
+}
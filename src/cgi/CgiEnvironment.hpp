@@ -0,0 +1,38 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiEnvironment.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 16:05:48 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 16:05:48 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+
+// A CGI environment kept as one contiguous "NAME=value\0NAME=value\0" arena.
+// It starts as a copy of the location's precomputed template, gets the
+// per-request variables appended, and envp() then points straight into it.
+class CgiEnvironment
+{
+	public:
+		CgiEnvironment();
+
+		void assign(const std::string &locationTemplate);
+		void add(const std::string &name, const std::string &value);
+		// Adds a request header as HTTP_NAME, uppercased with '-' as '_'
+		void addHeader(const std::string &header, const std::string &value);
+
+		// NULL-terminated array into the arena; valid until the next add
+		char **envp();
+		// Encodes every variable as FastCGI name-value pairs
+		void appendFastCgiParams(std::string &params) const;
+
+	private:
+		std::string _arena;
+		std::vector<char *> _pointers;
+};
@@ -17,6 +17,13 @@
 #include "../config/ServerConfig.hpp"
 #include "../config/LocationConfig.hpp"
 #include "../utils/Logger.hpp"
+#include "CgiOutputParser.hpp"
+#include "CgiEnvironment.hpp"
+#include "FastCgi.hpp"
+#include "FastCgiPool.hpp"
+#include "CgiWorkerPool.hpp"
+#include "CgiLimiter.hpp"
+#include "CgiCache.hpp"
 
 class CgiHandler
 {
@@ -26,24 +33,122 @@ class CgiHandler
 				const LocationConfig &location);
 		~CgiHandler();
 
-		Response execute();
+		// Validates the script and launches it. When it returns false,
+		// `response` holds what to send instead: an error, or a copy from
+		// the location's cgi_cache.
+		bool start(Response &response);
+		// Makes the script read a body of `length` bytes that is still
+		// arriving, passed in through acceptBody(). Called before start().
+		void streamBody(size_t length);
+		// Takes what fits of the next `len` body bytes and returns how many
+		// that is; 0 means the script is behind and the client should wait
+		size_t acceptBody(const char *data, size_t len);
+
+		pid_t getPid() const;
+
+		// Called by CgiWorkerPool when a pooled worker is free for us
+		void attachWorker(int fd);
+		// Called by CgiLimiter when a queued request may run, or has waited
+		// past its deadline
+		void runQueued();
+		void rejectQueued();
+		// Called by CgiCache for a request that waited on an identical one:
+		// with the response they share, or to run by itself after all
+		void deliver(const Response &response);
+		void runAlone();
+
+		// Event loop integration: the pipes to a forked script, or the
+		// connection to a FastCGI server. Output is only polled for when
+		// `readOutput` is set, which is how the client applies backpressure.
+		void collectPollFds(std::vector<struct pollfd> &fds, bool readOutput) const;
+		void handleEvent(int fd, short revents, std::string &out);
+		void handleExit(int status);
+		// Called about once a second to enforce the location's cgi_timeout
+		void checkTimeout(time_t now);
+
+		// With cgi_splice, body bytes move from a forked script's stdout to
+		// the client socket inside the kernel once the headers are out.
+		// True when some are waiting in the pipe; spliceOutput() sends the
+		// next slice and returns false when the connection failed.
+		bool hasSpliceable() const;
+		bool spliceOutput(int socket);
+
+		bool isComplete() const;
+		bool finishOutput(std::string &out);
+		// True when the script handed the response over to a file the
+		// server sends itself; `head` gets the headers it sent with it
+		bool getInternalRedirect(Response &head) const;
 
 	private:
-		Request _request;
-		ServerConfig _config;
-		LocationConfig _location;
-		std::map<std::string, std::string> _env;
+		// All three outlive the handler: the client deletes its CGI before
+		// the request, and configs live as long as the server
+		const Request &_request;
+		const ServerConfig &_config;
+		const LocationConfig &_location;
+		std::string _scriptPath;
+		std::string _interpreter;
+		CgiEnvironment _env;
+
+		pid_t _pid;
+		int _inputFd;
+		int _outputFd;
+		size_t _bodyOffset;
+		bool _exited;
+		bool _crashed;
+		CgiOutputParser _parser;
+
+		int _fcgiFd;
+		bool _fcgiConnecting;
+		bool _fcgiReused;
+		bool _fcgiReceived;
+		bool _fcgiStdinDone;
+		std::string _fcgiOut;
+		std::string _fcgiIn;
+		std::string _poolKey;
+		bool _limited;
+		int _failStatus;
+		time_t _deadline;
+		time_t _killAt;
+		bool _timedOut;
+		std::string _cacheKey;
+		bool _leading;
+		bool _following;
+		bool _hasShared;
+		Response _shared;
+		bool _streaming;
+		size_t _bodyLength;
+		size_t _bodyReceived;
+		std::string _bodyPending;
+		size_t _spliceable;
 
 		std::string _resolveScriptPath() const;
 		void _initEnv();
-		std::string _executeCgiSync(const std::string &scriptPath);
-		void _parseCgiOutput(const std::string &output, Response &response);
+		int _run();
+		bool _launch();
+		bool _spawn();
+		void _fail(int status);
+		void _buildError(Response &response, int status) const;
+		int _gatewayStatus() const;
+		const char *_inputData() const;
+		size_t _inputAvailable() const;
+		void _inputConsumed(size_t n);
+		bool _inputFinished() const;
+		bool _discardsInput() const;
+		void _writeInput();
+		void _readOutput(std::string &out);
+		bool _splicing() const;
+		void _checkSpliceable();
+		bool _startFastCgi();
+		void _beginFastCgiRequest();
+		void _releaseConnection(bool reusable);
+		void _fillFastCgiOutput();
+		void _handleFastCgi(short revents, std::string &out);
+		void _readFastCgi(std::string &out);
+		void _endFastCgi(bool clean);
+		void _failFastCgi();
+		void _closeFd(int &fd);
 		std::string _intToString(int value) const;
-		char** _createEnvArray() const;
-		void _cleanupEnvArray(char** env) const;
-		void _changeToScriptDirectory(const std::string& scriptPath);
-		void _execScript(const std::string& scriptPath, char** env);
-		bool _validateScript(const std::string& scriptPath);
+		bool _validateScript() const;
 
 		CgiHandler();
 		CgiHandler(const CgiHandler&);
@@ -0,0 +1,111 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiLimiter.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 16:48:21 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 16:48:21 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiLimiter.hpp"
+#include "CgiHandler.hpp"
+#include "../utils/Metrics.hpp"
+
+// Locations live as long as the server, so their address identifies them
+std::map<const LocationConfig *, CgiLimiter::Limit> CgiLimiter::_limits;
+
+CgiLimiter::Admission CgiLimiter::acquire(const LocationConfig &location, CgiHandler *handler)
+{
+	if (location.getCgiMaxConcurrent() == 0)
+		return ADMITTED;
+
+	Limit &limit = _limits[&location];
+	Admission admission = ADMITTED;
+
+	if (limit.running < location.getCgiMaxConcurrent() && limit.queue.empty()) {
+		limit.running++;
+	} else if (limit.queue.size() < location.getCgiQueueSize()) {
+		Waiter waiter;
+		waiter.handler = handler;
+		waiter.deadline = Metrics::now() + location.getCgiQueueTimeout();
+		limit.queue.push_back(waiter);
+		admission = QUEUED;
+	} else {
+		Metrics::increment(Metrics::label("cgi_rejected_total", "location", location.getPath()));
+		admission = REFUSED;
+	}
+	_updateGauges(location, limit);
+	return admission;
+}
+
+void CgiLimiter::release(const LocationConfig &location, CgiHandler *handler)
+{
+	std::map<const LocationConfig *, Limit>::iterator it = _limits.find(&location);
+	if (it == _limits.end())
+		return;
+	Limit &limit = it->second;
+
+	for (std::deque<Waiter>::iterator w = limit.queue.begin(); w != limit.queue.end(); ++w) {
+		if (w->handler == handler) {
+			limit.queue.erase(w);
+			_updateGauges(location, limit);
+			return;
+		}
+	}
+
+	if (limit.running > 0)
+		limit.running--;
+	_dispatch(location, limit);
+}
+
+void CgiLimiter::maintain(double now)
+{
+	for (std::map<const LocationConfig *, Limit>::iterator it = _limits.begin();
+		it != _limits.end(); ++it) {
+		std::deque<Waiter> &queue = it->second.queue;
+
+		// Deadlines are in arrival order
+		while (!queue.empty() && queue.front().deadline <= now) {
+			CgiHandler *handler = queue.front().handler;
+			queue.pop_front();
+			Metrics::increment(Metrics::label("cgi_queue_timeouts_total", "location",
+				it->first->getPath()));
+			_updateGauges(*it->first, it->second);
+			handler->rejectQueued();
+		}
+	}
+}
+
+// Dropped before the clients are, so destroying them does not start
+// queued scripts on the way out
+void CgiLimiter::forget(const LocationConfig &location)
+{
+	_limits.erase(&location);
+}
+
+void CgiLimiter::cleanup()
+{
+	_limits.clear();
+}
+
+void CgiLimiter::_dispatch(const LocationConfig &location, Limit &limit)
+{
+	while (limit.running < location.getCgiMaxConcurrent() && !limit.queue.empty()) {
+		CgiHandler *handler = limit.queue.front().handler;
+		limit.queue.pop_front();
+		limit.running++;
+		_updateGauges(location, limit);
+		handler->runQueued();
+	}
+	_updateGauges(location, limit);
+}
+
+void CgiLimiter::_updateGauges(const LocationConfig &location, const Limit &limit)
+{
+	const std::string &name = location.getPath();
+	Metrics::setGauge(Metrics::label("cgi_running", "location", name), limit.running);
+	Metrics::setGauge(Metrics::label("cgi_queued", "location", name), limit.queue.size());
+}
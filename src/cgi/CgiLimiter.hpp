@@ -0,0 +1,68 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiLimiter.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 16:48:21 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 16:48:21 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../config/LocationConfig.hpp"
+#include <deque>
+
+class CgiHandler;
+
+// Caps how many CGI requests of a location ("cgi_max_concurrent") run at
+// once. The excess waits in a bounded FIFO ("cgi_queue_size") until a slot
+// frees up or its deadline passes; beyond that requests are refused. Only
+// the CGI requests wait: the event loop keeps serving everything else.
+class CgiLimiter
+{
+	public:
+		enum Admission
+		{
+			ADMITTED,
+			QUEUED,
+			REFUSED
+		};
+
+		// ADMITTED means `handler` may run now. QUEUED handlers are resumed
+		// through runQueued() or rejectQueued() later.
+		static Admission acquire(const LocationConfig &location, CgiHandler *handler);
+		// Frees the handler's slot, or its place in the queue
+		static void release(const LocationConfig &location, CgiHandler *handler);
+		// Rejects waiters whose deadline has passed
+		static void maintain(double now);
+
+		// Drops the state of a location whose configuration is unloaded
+		static void forget(const LocationConfig &location);
+		static void cleanup();
+
+	private:
+		struct Waiter
+		{
+			CgiHandler *handler;
+			double deadline;
+		};
+
+		struct Limit
+		{
+			size_t running;
+			std::deque<Waiter> queue;
+
+			Limit() : running(0) {}
+		};
+
+		static std::map<const LocationConfig *, Limit> _limits;
+
+		static void _dispatch(const LocationConfig &location, Limit &limit);
+		static void _updateGauges(const LocationConfig &location, const Limit &limit);
+
+		CgiLimiter();
+};
@@ -0,0 +1,274 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiOutputParser.cpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 11:40:27 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 11:40:27 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiOutputParser.hpp"
+
+// Output that has not produced a header block by this size is treated as a
+// headerless body, like output that never produces one at all
+static const size_t MAX_CGI_HEADER_SIZE = 65536;
+
+CgiOutputParser::CgiOutputParser()
+	: _headersSent(false), _hasOutput(false), _chunkedAllowed(true),
+	_framing(CLOSE), _declaredLength(0), _bodySent(0), _captureLimit(0),
+	_capturing(false), _redirected(false)
+{}
+
+void CgiOutputParser::setChunkedAllowed(bool allowed) { _chunkedAllowed = allowed; }
+
+void CgiOutputParser::capture(size_t limit)
+{
+	_captureLimit = limit;
+	_capturing = true;
+}
+
+bool CgiOutputParser::getInternalRedirect(Response &head) const
+{
+	if (_redirected)
+		head = _redirectHead;
+	return _redirected;
+}
+
+bool CgiOutputParser::getCaptured(Response &response) const
+{
+	if (!_capturing || !_headersSent || _redirected)
+		return false;
+	response = _captured;
+	response.setBody(_capturedBody);
+	return true;
+}
+bool CgiOutputParser::hasOutput() const { return _hasOutput; }
+bool CgiOutputParser::headersSent() const { return _headersSent; }
+
+size_t CgiOutputParser::passThroughLimit() const
+{
+	if (!_headersSent || _capturing)
+		return 0;
+	if (_framing == LENGTH)
+		return _declaredLength - std::min(_bodySent, _declaredLength);
+	if (_framing == CLOSE)
+		return static_cast<size_t>(-1);
+	return 0;
+}
+
+void CgiOutputParser::passedThrough(size_t len)
+{
+	_bodySent += len;
+}
+
+void CgiOutputParser::feed(const char *data, size_t len, std::string &out)
+{
+	if (len == 0)
+		return;
+	_hasOutput = true;
+
+	if (_headersSent) {
+		_sendBody(data, len, out);
+		return;
+	}
+
+	_headerBuffer.append(data, len);
+
+	size_t headerEnd;
+	size_t bodyStart;
+	if (!_findHeaderEnd(headerEnd, bodyStart)) {
+		if (_headerBuffer.size() > MAX_CGI_HEADER_SIZE) {
+			Response response;
+			std::string body;
+			body.swap(_headerBuffer);
+			_sendHead(response, out);
+			_sendBody(body.data(), body.size(), out);
+		}
+		return;
+	}
+
+	Response response;
+	_parseHeaderBlock(_headerBuffer.substr(0, headerEnd), response);
+
+	// The server sends the named file itself; whatever the script writes
+	// after these headers is not the response
+	if (!response.getHeader("X-Accel-Redirect").empty()
+		|| !response.getHeader("X-Sendfile").empty()) {
+		_redirected = true;
+		_redirectHead = response;
+		_framing = DISCARD;
+		_headersSent = true;
+		_headerBuffer.clear();
+		return;
+	}
+	_sendHead(response, out);
+
+	std::string body = _headerBuffer.substr(bodyStart);
+	_headerBuffer.clear();
+	_sendBody(body.data(), body.size(), out);
+}
+
+bool CgiOutputParser::finish(std::string &out)
+{
+	if (!_headersSent) {
+		// No header block at all: everything the script wrote is the body
+		Response response;
+		response.setBody(_headerBuffer);
+		response.appendTo(out);
+		if (_capturing && _headerBuffer.size() <= _captureLimit)
+			_captured = response;
+		else
+			_capturing = false;
+		_headerBuffer.clear();
+		_headersSent = true;
+		return true;
+	}
+
+	if (_framing == CHUNKED) {
+		out += "0\r\n\r\n";
+		return true;
+	}
+	if (_framing == DISCARD)
+		return true;
+	if (_framing == LENGTH)
+		return _bodySent == _declaredLength;
+	return false;
+}
+
+// Scripts end their header block with either CRLF CRLF or a bare LF LF
+bool CgiOutputParser::_findHeaderEnd(size_t &headerEnd, size_t &bodyStart) const
+{
+	size_t crlf = _headerBuffer.find("\r\n\r\n");
+	size_t lf = _headerBuffer.find("\n\n");
+
+	if (crlf == std::string::npos && lf == std::string::npos)
+		return false;
+	if (lf == std::string::npos || (crlf != std::string::npos && crlf < lf)) {
+		headerEnd = crlf;
+		bodyStart = crlf + 4;
+	} else {
+		headerEnd = lf;
+		bodyStart = lf + 2;
+	}
+	return true;
+}
+
+static std::string trim(const std::string& str)
+{
+	size_t first = str.find_first_not_of(" \t\r\n");
+	if (first == std::string::npos) {
+		return "";
+	}
+	size_t last = str.find_last_not_of(" \t\r\n");
+	return str.substr(first, (last - first + 1));
+}
+
+static bool equalsIgnoreCase(const std::string &a, const char *b)
+{
+	size_t len = std::strlen(b);
+	if (a.size() != len)
+		return false;
+	for (size_t i = 0; i < len; ++i) {
+		if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+			return false;
+	}
+	return true;
+}
+
+void CgiOutputParser::_parseHeaderBlock(const std::string &headers, Response &response)
+{
+	std::istringstream headerStream(headers);
+	std::string headerLine;
+	while (std::getline(headerStream, headerLine)) {
+		if (headerLine.empty()) continue;
+		if (headerLine[headerLine.size()-1] == '\r') {
+			headerLine.erase(headerLine.size()-1);
+		}
+
+		size_t colonPos = headerLine.find(':');
+		if (colonPos == std::string::npos)
+			continue;
+
+		std::string key = headerLine.substr(0, colonPos);
+		std::string value = trim(headerLine.substr(colonPos + 1));
+
+		if (equalsIgnoreCase(key, "Status")) {
+			size_t spacePos = value.find(' ');
+			if (spacePos != std::string::npos) {
+				std::string code = value.substr(0, spacePos);
+				std::string message = value.substr(spacePos + 1);
+				response.setStatus(atoi(code.c_str()), message);
+			} else {
+				response.setStatus(atoi(value.c_str()), "OK");
+			}
+		}
+		else if (equalsIgnoreCase(key, "Content-Length")) {
+			response.setHeader("Content-Length", value);
+		}
+		else if (equalsIgnoreCase(key, "X-Accel-Redirect")) {
+			response.setHeader("X-Accel-Redirect", value);
+		}
+		else if (equalsIgnoreCase(key, "X-Sendfile")) {
+			response.setHeader("X-Sendfile", value);
+		}
+		// Framing is ours to decide, not the script's
+		else if (!equalsIgnoreCase(key, "Transfer-Encoding")
+			&& !equalsIgnoreCase(key, "Connection")) {
+			response.setHeader(key, value);
+		}
+	}
+}
+
+void CgiOutputParser::_sendHead(Response &response, std::string &out)
+{
+	const std::string &contentLength = response.getHeader("Content-Length");
+
+	// Before the framing headers, which depend on the client
+	if (_capturing)
+		_captured = response;
+
+	if (!contentLength.empty()) {
+		_framing = LENGTH;
+		_declaredLength = std::strtoul(contentLength.c_str(), NULL, 10);
+	} else if (_chunkedAllowed) {
+		_framing = CHUNKED;
+		response.setHeader("Transfer-Encoding", "chunked");
+	} else {
+		_framing = CLOSE;
+		response.setHeader("Connection", "close");
+	}
+
+	out += response.toHeaderString();
+	_headersSent = true;
+}
+
+void CgiOutputParser::_sendBody(const char *data, size_t len, std::string &out)
+{
+	if (len == 0 || _framing == DISCARD)
+		return;
+
+	if (_framing == CHUNKED) {
+		std::ostringstream size;
+		size << std::hex << len << "\r\n";
+		out += size.str();
+		out.append(data, len);
+		out += "\r\n";
+	} else if (_framing == LENGTH) {
+		// Anything past the declared length would corrupt the next response
+		len = std::min(len, _declaredLength - std::min(_bodySent, _declaredLength));
+		out.append(data, len);
+	} else {
+		out.append(data, len);
+	}
+	_bodySent += len;
+
+	if (_capturing && _capturedBody.size() + len > _captureLimit) {
+		_capturing = false;
+		std::string().swap(_capturedBody);
+	} else if (_capturing) {
+		_capturedBody.append(data, len);
+	}
+}
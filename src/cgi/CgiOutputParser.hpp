@@ -0,0 +1,80 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiOutputParser.hpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 11:40:27 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 11:40:27 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../http/Response.hpp"
+
+// Turns a script's stdout into HTTP bytes as it is produced. The CGI header
+// block becomes the status line and headers as soon as it is complete; body
+// data is forwarded straight away, chunk-framed unless the script declared
+// a Content-Length.
+class CgiOutputParser
+{
+	public:
+		CgiOutputParser();
+
+		// Chunked framing needs an HTTP/1.1 client; otherwise a body of unknown
+		// length is delimited by closing the connection
+		void setChunkedAllowed(bool allowed);
+		// Keeps a copy of the response as parsed, for the cache, as long as
+		// its body stays within `limit` bytes
+		void capture(size_t limit);
+
+		void feed(const char *data, size_t len, std::string &out);
+
+		// Flushes whatever is pending at end of output. Returns false when the
+		// connection must be closed once `out` has been sent.
+		bool finish(std::string &out);
+
+		bool hasOutput() const;
+		bool headersSent() const;
+		// How much more body may bypass feed(), sent verbatim by the caller:
+		// 0 unless the headers are out and the body needs no framing or copy
+		size_t passThroughLimit() const;
+		void passedThrough(size_t len);
+		// The captured response with its whole body; false when it was not
+		// captured or outgrew the limit
+		bool getCaptured(Response &response) const;
+		// True when the script answered with X-Accel-Redirect or X-Sendfile.
+		// Its body is dropped; `head` gets the headers it sent.
+		bool getInternalRedirect(Response &head) const;
+
+	private:
+		enum Framing
+		{
+			LENGTH,
+			CHUNKED,
+			CLOSE,
+			DISCARD
+		};
+
+		std::string _headerBuffer;
+		bool _headersSent;
+		bool _hasOutput;
+		bool _chunkedAllowed;
+		Framing _framing;
+		size_t _declaredLength;
+		size_t _bodySent;
+		size_t _captureLimit;
+		bool _capturing;
+		Response _captured;
+		std::string _capturedBody;
+		bool _redirected;
+		Response _redirectHead;
+
+		bool _findHeaderEnd(size_t &headerEnd, size_t &bodyStart) const;
+		void _parseHeaderBlock(const std::string &headers, Response &response);
+		void _sendHead(Response &response, std::string &out);
+		void _sendBody(const char *data, size_t len, std::string &out);
+};
@@ -0,0 +1,370 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiWorkerPool.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 15:34:02 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 15:34:02 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiWorkerPool.hpp"
+#include "CgiHandler.hpp"
+#include "../utils/Metrics.hpp"
+#include <sys/un.h>
+
+// A worker dying younger than this delays the next respawn by as much, so an
+// interpreter that cannot start does not fork in a tight loop
+static const double RESPAWN_BACKOFF = 1.0;
+
+// Worker sockets live in a directory only this process can enter, so no other
+// local user can connect to a worker or plant a socket at its path
+static const char SOCKET_DIR_TEMPLATE[] = "/tmp/webserv-cgi-XXXXXX";
+
+std::map<std::string, CgiWorkerPool::Pool> CgiWorkerPool::_pools;
+std::string CgiWorkerPool::_socketDir;
+unsigned long CgiWorkerPool::_sockets = 0;
+
+static std::string toString(unsigned long value)
+{
+	std::ostringstream oss;
+	oss << value;
+	return oss.str();
+}
+
+void CgiWorkerPool::configure(const std::deque<ServerConfig> &servers)
+{
+	for (std::map<std::string, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it) {
+		it->second.size = 0;
+		it->second.maxRequests = 0;
+	}
+
+	for (size_t i = 0; i < servers.size(); ++i) {
+		const std::map<std::string, LocationConfig> &locations = servers[i].getLocations();
+		for (std::map<std::string, LocationConfig>::const_iterator loc = locations.begin();
+			loc != locations.end(); ++loc) {
+			if (loc->second.getCgiPoolSize() == 0)
+				continue;
+
+			// Locations sharing an interpreter share its pool, sized for the
+			// largest of them
+			const std::map<std::string, std::string> &cgis = loc->second.getCgis();
+			for (std::map<std::string, std::string>::const_iterator cgi = cgis.begin();
+				cgi != cgis.end(); ++cgi) {
+				Pool &pool = _pools[cgi->second];
+				if (pool.interpreter.empty()) {
+					pool.interpreter = cgi->second;
+					pool.size = 0;
+					pool.maxRequests = 0;
+					pool.respawnAt = 0;
+				}
+				pool.size = std::max(pool.size, loc->second.getCgiPoolSize());
+				pool.maxRequests = std::max(pool.maxRequests, loc->second.getCgiPoolMaxRequests());
+			}
+		}
+	}
+
+	double now = Metrics::now();
+	for (std::map<std::string, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it) {
+		_fill(it->second, now);
+		Logger::info("CGI pool for " + it->first + ": "
+			+ toString(it->second.workers.size()) + " workers");
+	}
+}
+
+bool CgiWorkerPool::acquire(const std::string &interpreter, CgiHandler *handler)
+{
+	std::map<std::string, Pool>::iterator it = _pools.find(interpreter);
+	if (it == _pools.end() || it->second.size == 0)
+		return false;
+
+	Waiter waiter;
+	waiter.handler = handler;
+	waiter.queuedAt = Metrics::now();
+	it->second.queue.push_back(waiter);
+	_dispatch(it->second);
+	return true;
+}
+
+void CgiWorkerPool::release(const std::string &interpreter, int fd, bool reusable)
+{
+	std::map<std::string, Pool>::iterator it = _pools.find(interpreter);
+	if (it == _pools.end())
+		return;
+	Pool &pool = it->second;
+
+	for (size_t i = 0; i < pool.workers.size(); ++i) {
+		Worker &worker = pool.workers[i];
+		if (worker.fd != fd || fd < 0)
+			continue;
+
+		close(worker.fd);
+		worker.fd = -1;
+		if (!reusable || worker.pid < 0) {
+			_remove(pool, i, SIGKILL);
+		} else if (++worker.served >= pool.maxRequests && pool.maxRequests > 0) {
+			// Recycled; php-cgi has exited by itself if it counted the same
+			Metrics::increment(Metrics::label("cgi_pool_recycled_total", "interpreter", interpreter));
+			_remove(pool, i, SIGTERM);
+		} else {
+			worker.busy = false;
+		}
+		break;
+	}
+
+	_fill(pool, Metrics::now());
+	_dispatch(pool);
+}
+
+void CgiWorkerPool::cancel(CgiHandler *handler)
+{
+	for (std::map<std::string, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it) {
+		std::deque<Waiter> &queue = it->second.queue;
+		for (std::deque<Waiter>::iterator w = queue.begin(); w != queue.end(); ++w) {
+			if (w->handler == handler) {
+				queue.erase(w);
+				_updateGauges(it->second);
+				return;
+			}
+		}
+	}
+}
+
+bool CgiWorkerPool::handleChildExit(pid_t pid, int status)
+{
+	(void)status;
+	double now = Metrics::now();
+
+	for (std::map<std::string, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it) {
+		Pool &pool = it->second;
+		for (size_t i = 0; i < pool.workers.size(); ++i) {
+			if (pool.workers[i].pid != pid)
+				continue;
+
+			// php-cgi exits by itself once it has served PHP_FCGI_MAX_REQUESTS,
+			// possibly before the last request is released
+			if (pool.maxRequests > 0 && pool.workers[i].served + 1 >= pool.maxRequests) {
+				Metrics::increment(Metrics::label("cgi_pool_recycled_total", "interpreter",
+					pool.interpreter));
+			} else {
+				Logger::warn("CGI worker for " + pool.interpreter + " died");
+				Metrics::increment(Metrics::label("cgi_pool_crashes_total", "interpreter",
+					pool.interpreter));
+				if (now - pool.workers[i].spawnedAt < RESPAWN_BACKOFF)
+					pool.respawnAt = now + RESPAWN_BACKOFF;
+			}
+
+			// A busy worker's request sees EOF on the socket and releases it
+			if (pool.workers[i].busy)
+				pool.workers[i].pid = -1;
+			else
+				_remove(pool, i, 0);
+			return true;
+		}
+	}
+	return false;
+}
+
+void CgiWorkerPool::maintain(double now)
+{
+	for (std::map<std::string, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it) {
+		_fill(it->second, now);
+		_dispatch(it->second);
+	}
+}
+
+void CgiWorkerPool::cleanup()
+{
+	for (std::map<std::string, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it) {
+		while (!it->second.workers.empty())
+			_remove(it->second, it->second.workers.size() - 1, SIGTERM);
+	}
+	_pools.clear();
+
+	if (!_socketDir.empty()) {
+		rmdir(_socketDir.c_str());
+		_socketDir.clear();
+	}
+}
+
+// A listening socket at `path`, replacing whatever a previous run left there
+int CgiWorkerPool::_listen(const std::string &path)
+{
+	struct sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+		return -1;
+	std::strcpy(addr.sun_path, path.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	unlink(path.c_str());
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+		close(fd);
+		unlink(path.c_str());
+		return -1;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+}
+
+// The listener exists before the worker runs and the worker is idle, so the
+// connection completes at once and the worker accepts it when it is ready
+int CgiWorkerPool::_connect(const std::string &path)
+{
+	struct sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::strcpy(addr.sun_path, path.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+}
+
+bool CgiWorkerPool::_spawn(Pool &pool)
+{
+	// Created with the first worker; mkdtemp makes it 0700
+	if (_socketDir.empty()) {
+		char dir[sizeof(SOCKET_DIR_TEMPLATE)];
+		std::memcpy(dir, SOCKET_DIR_TEMPLATE, sizeof(SOCKET_DIR_TEMPLATE));
+		if (!mkdtemp(dir))
+			return false;
+		_socketDir = dir;
+	}
+
+	std::string socketPath = _socketDir + "/worker-" + toString(_sockets++) + ".sock";
+	int listenFd = _listen(socketPath);
+	if (listenFd < 0)
+		return false;
+
+	// Built before forking; the child only execs
+	std::string maxRequests = "PHP_FCGI_MAX_REQUESTS=" + toString(pool.maxRequests);
+	const char *path = getenv("PATH");
+	std::string pathVar = std::string("PATH=") + (path ? path : "/usr/bin:/bin");
+	char *envp[] = {
+		const_cast<char *>(maxRequests.c_str()),
+		const_cast<char *>(pathVar.c_str()),
+		NULL
+	};
+	char *argv[] = { const_cast<char *>(pool.interpreter.c_str()), NULL };
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(listenFd);
+		unlink(socketPath.c_str());
+		return false;
+	}
+
+	if (pid == 0) {
+		setpgid(0, 0);
+		signal(SIGPIPE, SIG_DFL);
+		dup2(listenFd, STDIN_FILENO);
+		execve(argv[0], argv, envp);
+		_exit(127);
+	}
+
+	// Only the worker accepts on it
+	close(listenFd);
+	setpgid(pid, pid);
+
+	Worker worker;
+	worker.pid = pid;
+	worker.path = socketPath;
+	worker.fd = -1;
+	worker.busy = false;
+	worker.served = 0;
+	worker.spawnedAt = Metrics::now();
+	pool.workers.push_back(worker);
+	return true;
+}
+
+void CgiWorkerPool::_fill(Pool &pool, double now)
+{
+	// A reload made the pool smaller
+	for (size_t i = pool.workers.size(); i-- > 0 && pool.workers.size() > pool.size; ) {
+		if (!pool.workers[i].busy)
+			_remove(pool, i, SIGTERM);
+	}
+
+	if (now < pool.respawnAt)
+		return;
+
+	while (pool.workers.size() < pool.size) {
+		if (!_spawn(pool)) {
+			Logger::error("Cannot spawn CGI worker for " + pool.interpreter);
+			pool.respawnAt = now + RESPAWN_BACKOFF;
+			break;
+		}
+	}
+	_updateGauges(pool);
+}
+
+void CgiWorkerPool::_dispatch(Pool &pool)
+{
+	double now = Metrics::now();
+
+	for (size_t i = 0; i < pool.workers.size() && !pool.queue.empty(); ++i) {
+		Worker &worker = pool.workers[i];
+		if (worker.busy || worker.pid < 0)
+			continue;
+
+		worker.fd = _connect(worker.path);
+		if (worker.fd < 0) {
+			Logger::warn("Cannot connect to CGI worker for " + pool.interpreter);
+			_remove(pool, i--, SIGKILL);
+			continue;
+		}
+
+		Waiter waiter = pool.queue.front();
+		pool.queue.pop_front();
+		worker.busy = true;
+
+		Metrics::observe(Metrics::label("cgi_pool_wait_seconds", "interpreter", pool.interpreter),
+			now - waiter.queuedAt);
+		Metrics::increment(Metrics::label("cgi_pool_requests_total", "interpreter", pool.interpreter));
+		waiter.handler->attachWorker(worker.fd);
+	}
+	_updateGauges(pool);
+}
+
+// Closes a worker's connection, removes its socket and forgets it; the
+// process is reaped by the event loop like any other child
+void CgiWorkerPool::_remove(Pool &pool, size_t index, int sig)
+{
+	Worker &worker = pool.workers[index];
+	if (worker.fd >= 0)
+		close(worker.fd);
+	unlink(worker.path.c_str());
+	if (sig && worker.pid > 0)
+		kill(-worker.pid, sig);
+	pool.workers.erase(pool.workers.begin() + index);
+	_updateGauges(pool);
+}
+
+void CgiWorkerPool::_updateGauges(const Pool &pool)
+{
+	size_t busy = 0;
+	for (size_t i = 0; i < pool.workers.size(); ++i) {
+		if (pool.workers[i].busy)
+			busy++;
+	}
+
+	const std::string &name = pool.interpreter;
+	Metrics::setGauge(Metrics::label("cgi_pool_workers", "interpreter", name), pool.workers.size());
+	Metrics::setGauge(Metrics::label("cgi_pool_busy", "interpreter", name), busy);
+	Metrics::setGauge(Metrics::label("cgi_pool_queued", "interpreter", name), pool.queue.size());
+	Metrics::setGauge(Metrics::label("cgi_pool_utilization", "interpreter", name),
+		pool.size ? static_cast<double>(busy) / pool.size : 0);
+}
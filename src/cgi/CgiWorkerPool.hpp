@@ -0,0 +1,96 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiWorkerPool.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 15:34:02 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 15:34:02 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../config/ServerConfig.hpp"
+#include "../utils/Logger.hpp"
+#include <deque>
+
+class CgiHandler;
+
+// Pre-spawned interpreter processes for locations with "cgi_pool". Each
+// worker gets its own listening Unix socket as its stdin. php-cgi (and any
+// interpreter that does the same) takes a listening socket on stdin as the
+// cue to serve FastCGI: it accepts one connection at a time, which a request
+// opens when it is handed the worker, without a fork per request. Requests
+// that find every worker busy wait in a FIFO.
+class CgiWorkerPool
+{
+	public:
+		// Creates the pools every location asks for and spawns their workers.
+		// Called again on reload, pools are resized to the new configuration;
+		// idle workers beyond that are stopped, busy ones once they are done.
+		static void configure(const std::deque<ServerConfig> &servers);
+
+		// Hands `handler` a connection to an idle worker through
+		// attachWorker(), now or once one frees up. Returns false when there
+		// is no pool for `interpreter`, or it was sized down to nothing.
+		static bool acquire(const std::string &interpreter, CgiHandler *handler);
+		// Closes the request's connection and gives its worker back; one that
+		// is not `reusable` is killed and replaced
+		static void release(const std::string &interpreter, int fd, bool reusable);
+		// Drops a handler that is still waiting in a queue
+		static void cancel(CgiHandler *handler);
+
+		// Returns true when `pid` was one of the workers
+		static bool handleChildExit(pid_t pid, int status);
+		// Respawns missing workers
+		static void maintain(double now);
+
+		static void cleanup();
+
+	private:
+		struct Worker
+		{
+			pid_t pid;
+			// The socket the worker listens on, and the connection of the
+			// request it is serving (-1 while idle)
+			std::string path;
+			int fd;
+			bool busy;
+			unsigned long served;
+			double spawnedAt;
+		};
+
+		struct Waiter
+		{
+			CgiHandler *handler;
+			double queuedAt;
+		};
+
+		struct Pool
+		{
+			std::string interpreter;
+			size_t size;
+			unsigned long maxRequests;
+			std::vector<Worker> workers;
+			std::deque<Waiter> queue;
+			double respawnAt;
+		};
+
+		static std::map<std::string, Pool> _pools;
+		// Private directory holding the worker sockets
+		static std::string _socketDir;
+		static unsigned long _sockets;
+
+		static int _listen(const std::string &path);
+		static int _connect(const std::string &path);
+		static bool _spawn(Pool &pool);
+		static void _fill(Pool &pool, double now);
+		static void _dispatch(Pool &pool);
+		static void _remove(Pool &pool, size_t index, int sig);
+		static void _updateGauges(const Pool &pool);
+
+		CgiWorkerPool();
+};
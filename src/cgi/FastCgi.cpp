@@ -0,0 +1,103 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgi.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 14:31:09 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 14:31:09 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "FastCgi.hpp"
+
+static const unsigned char FCGI_VERSION = 1;
+static const unsigned char FCGI_RESPONDER = 1;
+static const unsigned char FCGI_KEEP_CONN = 1;
+
+const size_t FastCgi::HEADER_SIZE;
+const size_t FastCgi::MAX_CONTENT;
+const unsigned char FastCgi::REQUEST_COMPLETE;
+
+void FastCgi::_appendHeader(std::string &out, int type, int requestId,
+							size_t contentLength, size_t paddingLength)
+{
+	out += static_cast<char>(FCGI_VERSION);
+	out += static_cast<char>(type);
+	out += static_cast<char>((requestId >> 8) & 0xff);
+	out += static_cast<char>(requestId & 0xff);
+	out += static_cast<char>((contentLength >> 8) & 0xff);
+	out += static_cast<char>(contentLength & 0xff);
+	out += static_cast<char>(paddingLength);
+	out += '\0';
+}
+
+// Lengths below 128 take one byte; longer ones four, with the top bit set
+void FastCgi::_appendLength(std::string &out, size_t len)
+{
+	if (len < 128) {
+		out += static_cast<char>(len);
+		return;
+	}
+	out += static_cast<char>(((len >> 24) & 0x7f) | 0x80);
+	out += static_cast<char>((len >> 16) & 0xff);
+	out += static_cast<char>((len >> 8) & 0xff);
+	out += static_cast<char>(len & 0xff);
+}
+
+void FastCgi::appendBeginRequest(std::string &out, int requestId)
+{
+	_appendHeader(out, BEGIN_REQUEST, requestId, 8, 0);
+	out += '\0';
+	out += static_cast<char>(FCGI_RESPONDER);
+	out += static_cast<char>(FCGI_KEEP_CONN);
+	out.append(5, '\0');
+}
+
+void FastCgi::appendParam(std::string &params, const char *name, size_t nameLen,
+						const char *value, size_t valueLen)
+{
+	_appendLength(params, nameLen);
+	_appendLength(params, valueLen);
+	params.append(name, nameLen);
+	params.append(value, valueLen);
+}
+
+void FastCgi::appendStream(std::string &out, RecordType type, int requestId,
+						const char *data, size_t len)
+{
+	if (len == 0) {
+		_appendHeader(out, type, requestId, 0, 0);
+		return;
+	}
+
+	while (len > 0) {
+		size_t n = std::min(len, MAX_CONTENT);
+		// Records are padded to a multiple of 8 bytes, as the spec recommends
+		size_t padding = (8 - n % 8) % 8;
+		_appendHeader(out, type, requestId, n, padding);
+		out.append(data, n);
+		out.append(padding, '\0');
+		data += n;
+		len -= n;
+	}
+}
+
+size_t FastCgi::parseRecord(const char *data, size_t len, Record &record)
+{
+	if (len < HEADER_SIZE)
+		return 0;
+
+	const unsigned char *header = reinterpret_cast<const unsigned char *>(data);
+	size_t contentLength = (header[4] << 8) | header[5];
+	size_t total = HEADER_SIZE + contentLength + header[6];
+	if (len < total)
+		return 0;
+
+	record.type = header[1];
+	record.requestId = (header[2] << 8) | header[3];
+	record.content = data + HEADER_SIZE;
+	record.contentLength = contentLength;
+	return total;
+}
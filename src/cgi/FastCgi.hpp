@@ -0,0 +1,62 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgi.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 14:31:09 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 14:31:09 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+
+// Wire format of the FastCGI protocol (version 1), responder role only
+class FastCgi
+{
+	public:
+		enum RecordType
+		{
+			BEGIN_REQUEST = 1,
+			ABORT_REQUEST = 2,
+			END_REQUEST = 3,
+			PARAMS = 4,
+			STDIN = 5,
+			STDOUT = 6,
+			STDERR = 7
+		};
+
+		static const size_t HEADER_SIZE = 8;
+		static const size_t MAX_CONTENT = 65535;
+		static const unsigned char REQUEST_COMPLETE = 0;
+
+		struct Record
+		{
+			int type;
+			int requestId;
+			const char *content;
+			size_t contentLength;
+		};
+
+		// BEGIN_REQUEST asking the application to keep the connection open
+		static void appendBeginRequest(std::string &out, int requestId);
+		// Name-value pairs are buffered in `params` and framed by appendStream
+		static void appendParam(std::string &params, const char *name, size_t nameLen,
+								const char *value, size_t valueLen);
+		// Frames `len` bytes as records of `type`; len == 0 writes the empty
+		// record that closes the stream
+		static void appendStream(std::string &out, RecordType type, int requestId,
+								const char *data, size_t len);
+
+		// Parses the record at the start of `data`. Returns the bytes it spans,
+		// padding included, or 0 when it is not complete yet.
+		static size_t parseRecord(const char *data, size_t len, Record &record);
+
+	private:
+		static void _appendHeader(std::string &out, int type, int requestId,
+								size_t contentLength, size_t paddingLength);
+		static void _appendLength(std::string &out, size_t len);
+};
@@ -0,0 +1,161 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgiPool.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 14:44:52 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 14:44:52 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "FastCgiPool.hpp"
+#include <sys/un.h>
+
+// Idle connections kept per address; beyond this they are simply closed
+static const size_t MAX_IDLE_PER_ADDRESS = 16;
+
+std::map<std::string, std::vector<int> > FastCgiPool::_idle;
+std::map<int, std::string> FastCgiPool::_idleAddress;
+
+int FastCgiPool::acquire(const std::string &address, bool &reused)
+{
+	std::map<std::string, std::vector<int> >::iterator it = _idle.find(address);
+	if (it != _idle.end() && !it->second.empty()) {
+		// Most recently used first: it is the least likely to have timed out
+		int fd = it->second.back();
+		it->second.pop_back();
+		_idleAddress.erase(fd);
+		reused = true;
+		return fd;
+	}
+
+	reused = false;
+	return _connect(address);
+}
+
+void FastCgiPool::release(const std::string &address, int fd)
+{
+	std::vector<int> &idle = _idle[address];
+	if (idle.size() >= MAX_IDLE_PER_ADDRESS) {
+		close(fd);
+		return;
+	}
+	idle.push_back(fd);
+	_idleAddress[fd] = address;
+}
+
+void FastCgiPool::discard(int fd)
+{
+	_removeIdle(fd);
+	close(fd);
+}
+
+void FastCgiPool::collectPollFds(std::vector<struct pollfd> &fds)
+{
+	struct pollfd pfd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	for (std::map<int, std::string>::const_iterator it = _idleAddress.begin();
+		it != _idleAddress.end(); ++it) {
+		pfd.fd = it->first;
+		fds.push_back(pfd);
+	}
+}
+
+// An idle connection has nothing to say: any event means the backend closed
+// it (or broke the protocol), so it is dropped
+void FastCgiPool::handleEvent(int fd, short revents)
+{
+	// It may have been handed out again earlier in this loop iteration
+	if (revents == 0 || _idleAddress.find(fd) == _idleAddress.end())
+		return;
+
+	Logger::info("FastCGI connection closed by " + _idleAddress[fd]);
+	discard(fd);
+}
+
+void FastCgiPool::cleanup()
+{
+	for (std::map<int, std::string>::iterator it = _idleAddress.begin();
+		it != _idleAddress.end(); ++it)
+		close(it->first);
+	_idleAddress.clear();
+	_idle.clear();
+}
+
+void FastCgiPool::_removeIdle(int fd)
+{
+	std::map<int, std::string>::iterator it = _idleAddress.find(fd);
+	if (it == _idleAddress.end())
+		return;
+
+	std::vector<int> &idle = _idle[it->second];
+	idle.erase(std::remove(idle.begin(), idle.end(), fd), idle.end());
+	_idleAddress.erase(it);
+}
+
+static bool resolveAddress(const std::string &address,
+						struct sockaddr_storage &addr, socklen_t &addrLen)
+{
+	std::memset(&addr, 0, sizeof(addr));
+
+	if (address.compare(0, 5, "unix:") == 0) {
+		std::string path = address.substr(5);
+		struct sockaddr_un *un = reinterpret_cast<struct sockaddr_un *>(&addr);
+		if (path.empty() || path.size() >= sizeof(un->sun_path))
+			return false;
+		un->sun_family = AF_UNIX;
+		std::memcpy(un->sun_path, path.c_str(), path.size() + 1);
+		addrLen = sizeof(struct sockaddr_un);
+		return true;
+	}
+
+	size_t colonPos = address.rfind(':');
+	if (colonPos == std::string::npos)
+		return false;
+	std::string host = address.substr(0, colonPos);
+	int port = std::atoi(address.substr(colonPos + 1).c_str());
+	if (host == "localhost")
+		host = "127.0.0.1";
+
+	struct sockaddr_in *in = reinterpret_cast<struct sockaddr_in *>(&addr);
+	in->sin_family = AF_INET;
+	in->sin_port = htons(port);
+	if (port < 1 || port > 65535 || inet_pton(AF_INET, host.c_str(), &in->sin_addr) <= 0)
+		return false;
+	addrLen = sizeof(struct sockaddr_in);
+	return true;
+}
+
+int FastCgiPool::_connect(const std::string &address)
+{
+	struct sockaddr_storage addr;
+	socklen_t addrLen;
+	if (!resolveAddress(address, addr, addrLen)) {
+		Logger::error("Invalid FastCGI address: " + address);
+		return -1;
+	}
+
+	int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0
+		|| fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	// Completion of a TCP connect is picked up with the first POLLOUT
+	if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), addrLen) < 0
+		&& errno != EINPROGRESS) {
+		Logger::error("Cannot connect to FastCGI server " + address);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
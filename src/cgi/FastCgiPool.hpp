@@ -0,0 +1,47 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgiPool.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 14:44:52 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 14:44:52 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../utils/Logger.hpp"
+
+// Persistent connections to FastCGI application servers, shared by every
+// server block. A connection carries one request at a time; when it is done
+// it goes back to the idle list of its address instead of being closed.
+class FastCgiPool
+{
+	public:
+		// Returns a non-blocking socket to `address` ("unix:/path" or
+		// "host:port"), reusing an idle one when there is one. The connect may
+		// still be in progress. Returns -1 on failure.
+		static int acquire(const std::string &address, bool &reused);
+		// Hands a connection whose request completed cleanly back to the pool
+		static void release(const std::string &address, int fd);
+		// Closes a connection that is in an unknown protocol state
+		static void discard(int fd);
+
+		// Idle connections are watched so a backend closing them is noticed
+		static void collectPollFds(std::vector<struct pollfd> &fds);
+		static void handleEvent(int fd, short revents);
+
+		static void cleanup();
+
+	private:
+		static std::map<std::string, std::vector<int> > _idle;
+		static std::map<int, std::string> _idleAddress;
+
+		static int _connect(const std::string &address);
+		static void _removeIdle(int fd);
+
+		FastCgiPool();
+};
@@ -12,89 +12,398 @@
 
 #include "Client.hpp"
 
-Client::Client(int fd, const struct sockaddr_in& addr, const ServerConfig &config)
-	: _fd(fd), _closed(false), _readBuffer(""), _writeBuffer(""),
-	_request(NULL), _config(config)
+// Requests whose header block grows past this without terminating are refused
+static const size_t MAX_HEADER_SIZE = 16384;
+// Bodies of refused requests up to this size are read and dropped so the
+// connection can be kept; anything larger gets the connection closed
+static const size_t MAX_DRAIN_SIZE = 65536;
+// While a CGI script runs, pipelined input is buffered up to this much
+static const size_t MAX_PENDING_INPUT = 65536;
+// CGI output is only read while less than this is waiting to be sent, so a
+// slow client throttles the script through the pipe
+static const size_t MAX_PENDING_OUTPUT = 262144;
+// After a refusal we keep reading (and discarding) for a while before closing,
+// so the peer sees our response instead of a reset
+static const size_t LINGER_MAX_BYTES = 1048576;
+static const time_t LINGER_TIMEOUT = 2;
+
+Client::Client(int fd, const struct sockaddr_in& addr, Routing &routing,
+			const std::string &listener)
+	: _fd(fd), _closed(false), _closeAfterWrite(false), _lingering(false),
+	_lingerDeadline(0), _lingerBytes(0), _readBuffer(""), _writeBuffer(""),
+	_request(NULL), _routing(&routing), _listener(listener),
+	_hosts(routing.findHosts(listener)), _config(&_hosts->defaultServer()), _cgi(NULL),
+	_state(READING_HEADERS), _headerScanPos(0), _bodyRemaining(0), _discardBody(false)
 {
 	char ipStr[INET_ADDRSTRLEN];
 	inet_ntop(AF_INET, &(addr.sin_addr), ipStr, INET_ADDRSTRLEN);
 	_clientAddress = ipStr;
+	_routing->retain();
 	Logger::info("New connection from: " + _clientAddress);
 }
 
 Client::~Client()
 {
+	delete _cgi;
 	if (_request) {
 		delete _request;
 	}
+	_routing->release();
 }
 
 int Client::getFd() const { return _fd; }
 const std::string& Client::getClientAddress() const { return _clientAddress; }
 bool Client::isClientClosed() const { return _closed; }
 
-bool Client::_hasCompleteRequest() const
+bool Client::handleClientRequest()
 {
-	size_t headerEnd = _readBuffer.find("\r\n\r\n");
+	char buffer[8192];
+	ssize_t bytesRead = recv(_fd, buffer, sizeof(buffer), 0);
+	if (bytesRead <= 0) { _closed = true; return false; }
+
+	// Once a response is queued for close, anything else the peer sends is
+	// dropped on the floor
+	if (_closeAfterWrite)
+	{
+		_lingerBytes += bytesRead;
+		return _lingerBytes < LINGER_MAX_BYTES;
+	}
+
+	_readBuffer.append(buffer, bytesRead);
+	_processReadBuffer();
+	return true;
+}
+
+void Client::_processReadBuffer()
+{
+	size_t offset = 0;
+	bool progress = true;
+
+	// A running CGI script or a file being sent holds back any pipelined
+	// request behind it; only the body the script is reading gets through
+	while (progress && !_closeAfterWrite && !_file.isOpen()
+		&& (!_cgi || _state == READING_BODY))
+	{
+		if (_state == READING_HEADERS)
+			progress = _parseHeaders(offset);
+		else
+			progress = _readBody(offset);
+	}
+	_readBuffer.erase(0, offset);
+	_headerScanPos = (_headerScanPos > offset) ? _headerScanPos - offset : 0;
+}
+
+bool Client::_parseHeaders(size_t &offset)
+{
+	// Resume the terminator search where the previous recv() left off
+	size_t searchFrom = std::max(offset, _headerScanPos);
+	if (searchFrom >= offset + 3)
+		searchFrom -= 3;
+	size_t headerEnd = _readBuffer.find("\r\n\r\n", searchFrom);
 	if (headerEnd == std::string::npos)
+	{
+		_headerScanPos = _readBuffer.size();
+		if (_readBuffer.size() - offset > MAX_HEADER_SIZE)
+			_rejectRequest(431);
+		return false;
+	}
+	if (headerEnd - offset > MAX_HEADER_SIZE)
+	{
+		_rejectRequest(431);
+		return false;
+	}
+
+	_followReload();
+	_request = new Request(_readBuffer.substr(offset, headerEnd + 4 - offset));
+	_config = &_hosts->select(_request->getReqHeaderKey("Host"));
+	offset = headerEnd + 4;
+	_headerScanPos = offset;
+
+	if (_request->getFramingError())
+	{
+		_rejectRequest(_request->getFramingError());
 		return false;
+	}
 
-	size_t contentLength = 0;
-	size_t clPos = _readBuffer.find("Content-Length:");
-	if (clPos != std::string::npos)
+	const std::string &clStr = _request->getReqHeaderKey("Content-Length");
+	_bodyRemaining = 0;
+	if (!clStr.empty() && !_request->isChunked())
 	{
-		size_t lineEnd = _readBuffer.find("\r\n", clPos);
-		std::string clStr = _readBuffer.substr(clPos + 15, lineEnd - (clPos + 15));
-		contentLength = std::atoi(clStr.c_str());
+		if (clStr.find_first_not_of("0123456789") != std::string::npos
+			|| clStr.size() > 15)
+		{
+			_rejectRequest(400);
+			return false;
+		}
+		_bodyRemaining = std::strtoul(clStr.c_str(), NULL, 10);
 	}
+	bool hasBody = _request->isChunked() || _bodyRemaining > 0;
 
-	return _readBuffer.size() >= headerEnd + 4 + contentLength;
+	// Location, method and size are all known now: refuse before a single
+	// byte of the body is read
+	Response refusal;
+	if (!RequestHandler::route(*_request, *_config, refusal)
+		|| !RequestHandler::admit(*_request, *_config, refusal))
+	{
+		_refuseRequest(refusal);
+		return !_closeAfterWrite;
+	}
+
+	if (!hasBody)
+	{
+		_dispatchRequest();
+		return true;
+	}
+
+	// A CGI script with a known body length starts right away and reads the
+	// body as it arrives, instead of after it has all been buffered
+	if (!_request->isChunked()
+		&& RequestHandler::startCgi(*_request, *_config, _cgi, refusal, _bodyRemaining)
+		&& !_cgi)
+	{
+		_refuseRequest(refusal);
+		return !_closeAfterWrite;
+	}
+
+	if (_expectsContinue())
+		_writeBuffer += "HTTP/1.1 100 Continue\r\n\r\n";
+
+	if (_request->isChunked())
+		_chunkedDecoder.reset();
+	_state = READING_BODY;
+	return true;
 }
 
-bool Client::handleClientRequest()
+bool Client::_readBody(size_t &offset)
+{
+	if (offset >= _readBuffer.size())
+		return false;
+
+	const char *data = _readBuffer.data() + offset;
+	size_t available = _readBuffer.size() - offset;
+
+	if (_cgi)
+	{
+		size_t n = _cgi->acceptBody(data, std::min(available, _bodyRemaining));
+		offset += n;
+		_bodyRemaining -= n;
+		// The request stays with the script until it finishes
+		if (_bodyRemaining == 0)
+			_state = READING_HEADERS;
+		return n > 0;
+	}
+
+	if (!_request->isChunked())
+	{
+		size_t n = std::min(available, _bodyRemaining);
+		if (!_discardBody && !_appendBody(data, n))
+			return false;
+		offset += n;
+		_bodyRemaining -= n;
+		if (_bodyRemaining == 0 && _discardBody)
+			_resetRequest();
+		else if (_bodyRemaining == 0)
+			_dispatchRequest();
+		return _bodyRemaining == 0;
+	}
+
+	const char *chunk;
+	size_t chunkLen;
+	size_t used = _chunkedDecoder.decode(data, available, chunk, chunkLen);
+	offset += used;
+
+	if (chunkLen > 0 && !_appendBody(chunk, chunkLen))
+		return false;
+	if (_chunkedDecoder.hasError())
+	{
+		_rejectRequest(400);
+		return false;
+	}
+	if (_chunkedDecoder.isDone())
+		_dispatchRequest();
+	return true;
+}
+
+// Single entry point for decoded body bytes, whatever the transfer framing
+bool Client::_appendBody(const char *data, size_t len)
+{
+	if (_request->getReqBody().size() + len > _config->getClientMaxBodySize())
+	{
+		_rejectRequest(413);
+		return false;
+	}
+	if (!_request->appendBody(data, len, _config->getClientBodyBufferSize()))
+	{
+		Logger::error("Cannot spool request body to disk");
+		_rejectRequest(500);
+		return false;
+	}
+	return true;
+}
+
+void Client::_dispatchRequest()
 {
-	// 1. Early body-size check before reading more data
-	size_t clPos = _readBuffer.find("Content-Length:");
-	if (clPos != std::string::npos)
+	_request->finalizeBody();
+	if (RequestHandler::startCgi(*_request, *_config, _cgi, _response, 0))
 	{
-		size_t lineEnd = _readBuffer.find("\r\n", clPos);
-		size_t contentLength = std::atoi(
-			_readBuffer.substr(clPos + 15, lineEnd - clPos - 15).c_str()
-		);
-		if (contentLength > _config.getClientMaxBodySize())
+		// The script runs asynchronously with the whole body in hand; the
+		// event loop resumes us later
+		if (_cgi)
 		{
-			Response resp;
-			HttpStatus::buildResponse(_config, resp, 413);
-			_writeBuffer = resp.toString();
+			_state = READING_HEADERS;
+			return;
+		}
+	}
+	else
+		_response = RequestHandler::handle(*_request, *_config, _file);
+	if (_file.isOpen())
+		_writeBuffer += _response.toHeaderString();
+	else
+		_response.appendTo(_writeBuffer);
+	_resetRequest();
+}
+
+void Client::_finishCgi()
+{
+	Response head;
+	if (_cgi->getInternalRedirect(head))
+	{
+		Response response;
+		RequestHandler::serveInternal(*_request, *_config, head, response, _file);
+		if (_file.isOpen())
+			_writeBuffer += response.toHeaderString();
+		else
+			response.appendTo(_writeBuffer);
+	}
+	else if (!_cgi->finishOutput(_writeBuffer))
+		_closeAfterWrite = true;
+	delete _cgi;
+	_cgi = NULL;
+
+	// A script may answer before reading all of a streamed body: the rest
+	// is drained when it is small, or the connection closed behind it
+	bool bodyPending = _state == READING_BODY && !_request->isChunked()
+		&& _bodyRemaining > 0;
+	if (bodyPending && !_closeAfterWrite && _bodyRemaining <= MAX_DRAIN_SIZE)
+		_discardBody = true;
+	else
+	{
+		if (bodyPending)
+		{
+			_closeAfterWrite = true;
 			_readBuffer.clear();
-			return true;  // schedule send of 413 immediately
 		}
+		_resetRequest();
 	}
+	_processReadBuffer();
+}
 
-	// 2. Now read incoming data
-	char buffer[8192];
-	ssize_t bytesRead = recv(_fd, buffer, sizeof(buffer), 0);
-	if (bytesRead <= 0) { _closed = true; return false; }
-	_readBuffer.append(buffer, bytesRead);
+// Answers with an error and gives up on the connection, since the position
+// in the byte stream can no longer be trusted
+void Client::_rejectRequest(int code)
+{
+	Response resp;
+	HttpStatus::buildResponse(*_config, resp, code);
+	resp.setHeader("Connection", "close");
+	resp.appendTo(_writeBuffer);
+	_closeAfterWrite = true;
+	_resetRequest();
+	_readBuffer.clear();
+}
+
+// Queues an admission refusal. The unread body is drained when it is small
+// and its length is known; otherwise the connection is closed behind it.
+void Client::_refuseRequest(Response &response)
+{
+	bool hasBody = _request->isChunked() || _bodyRemaining > 0;
 
-	// 3. Only when you’ve detected full headers and body, parse request
-	if (_hasCompleteRequest())
+	if (!hasBody)
 	{
-		_request = new Request(_readBuffer);
-		_response = RequestHandler::handle(*_request, _config);
-		_writeBuffer = _response.toString();
-		delete _request;
-		_request = NULL;
-		_readBuffer.clear();
+		response.appendTo(_writeBuffer);
+		_resetRequest();
+		return;
 	}
-	return true;
+
+	// A client waiting for 100 Continue will not send the body at all
+	if (!_request->isChunked() && !_expectsContinue()
+		&& _bodyRemaining <= MAX_DRAIN_SIZE)
+	{
+		response.appendTo(_writeBuffer);
+		_discardBody = true;
+		_state = READING_BODY;
+		return;
+	}
+
+	response.setHeader("Connection", "close");
+	response.appendTo(_writeBuffer);
+	_closeAfterWrite = true;
+	_resetRequest();
+	_readBuffer.clear();
+}
+
+bool Client::_expectsContinue() const
+{
+	std::string expect = _request->getReqHeaderKey("Expect");
+	std::transform(expect.begin(), expect.end(), expect.begin(), ::tolower);
+	return expect == "100-continue" && _request->getReqHttpVersion() == "HTTP/1.1";
 }
 
+void Client::_resetRequest()
+{
+	delete _request;
+	_request = NULL;
+	_state = READING_HEADERS;
+	_bodyRemaining = 0;
+	_discardBody = false;
+}
+
+// Between two requests nothing refers to the old configuration any more, so
+// a connection kept alive across a reload moves on to the new one, unless
+// its listener is not part of it
+void Client::_followReload()
+{
+	Routing *current = Routing::current();
+	if (current == _routing)
+		return;
+	const VirtualHosts *hosts = current->findHosts(_listener);
+	if (!hosts)
+		return;
+
+	current->retain();
+	_routing->release();
+	_routing = current;
+	_hosts = hosts;
+	_config = &hosts->defaultServer();
+	// May still point at a canned response of the old configuration
+	_response = Response();
+}
 
 bool Client::handleClientResponse()
 {
-	if (_writeBuffer.empty())
+	// The file goes out once the headers before it have
+	if (_writeBuffer.empty() && _file.isOpen())
+	{
+		if (!_file.send(_fd)) {
+			_closed = true;
+			return false;
+		}
+		if (!_file.isOpen())
+			_processReadBuffer();
 		return true;
+	}
+
+	// So does script output spliced from its pipe
+	if (_writeBuffer.empty() && _cgi && _cgi->hasSpliceable())
+	{
+		if (!_cgi->spliceOutput(_fd)) {
+			_closed = true;
+			return false;
+		}
+		return true;
+	}
+
+	if (_writeBuffer.empty())
+		return (_closeAfterWrite && !_lingering) ? _linger() : true;
 
 	ssize_t bytesWritten = send(_fd, _writeBuffer.c_str(), _writeBuffer.size(), 0);
 
@@ -105,9 +414,87 @@ bool Client::handleClientResponse()
 	}
 
 	_writeBuffer.erase(0, bytesWritten);
+	if (_writeBuffer.empty() && _closeAfterWrite)
+		return _linger();
 	return true;
 }
 
+// Half-closes the connection once the final response is out and lets the
+// peer finish sending for a bounded time, so closing does not reset it
+bool Client::_linger()
+{
+	if (!_lingering)
+	{
+		shutdown(_fd, SHUT_WR);
+		_lingering = true;
+		_lingerDeadline = time(NULL) + LINGER_TIMEOUT;
+	}
+	return time(NULL) < _lingerDeadline;
+}
+
+void Client::collectPollFds(std::vector<struct pollfd> &fds) const
+{
+	struct pollfd pfd;
+	pfd.fd = _fd;
+	pfd.events = 0;
+	pfd.revents = 0;
+
+	// Keep reading while a script runs, so a peer that hangs up is noticed,
+	// but leave large pipelined input waiting in the kernel
+	if ((!_cgi && !_file.isOpen()) || _readBuffer.size() < MAX_PENDING_INPUT)
+		pfd.events |= POLLIN;
+	// Lingering only waits for the peer's EOF or the deadline
+	if (!_writeBuffer.empty() || _file.isOpen() || (_cgi && _cgi->hasSpliceable())
+		|| (_closeAfterWrite && !_lingering))
+		pfd.events |= POLLOUT;
+	fds.push_back(pfd);
+
+	if (_cgi)
+		_cgi->collectPollFds(fds, _writeBuffer.size() < MAX_PENDING_OUTPUT);
+}
+
+void Client::handleCgiEvent(int fd, short revents)
+{
+	if (!_cgi)
+		return;
+
+	_cgi->handleEvent(fd, revents, _writeBuffer);
+	if (_cgi->isComplete())
+		_finishCgi();
+	// The script made room for more of a streamed body
+	else if (_state == READING_BODY)
+		_processReadBuffer();
+}
+
+void Client::handleChildExit(pid_t pid, int status)
+{
+	if (!_cgi || _cgi->getPid() != pid)
+		return;
+
+	_cgi->handleExit(status);
+	if (_cgi->isComplete())
+		_finishCgi();
+}
+
+void Client::checkCgi(time_t now)
+{
+	if (!_cgi)
+		return;
+	_cgi->checkTimeout(now);
+	if (_cgi->isComplete())
+		_finishCgi();
+}
+
+bool Client::isExpired(time_t now) const
+{
+	return _lingering && now >= _lingerDeadline;
+}
+
+void Client::markClosed()
+{
+	_closed = true;
+}
+
 void Client::closeClient()
 {
 	if (_fd > 0) {
@@ -14,35 +14,85 @@
 
 #include "../../inc/webserv.hpp"
 #include "../config/ServerConfig.hpp"
+#include "../servers/Routing.hpp"
 #include "../http/Request.hpp"
 #include "../http/Response.hpp"
 #include "../http/RequestHandler.hpp"
+#include "../http/ChunkedDecoder.hpp"
 #include "../utils/Logger.hpp"
 
 class Client
 {
 	public:
-		Client(int fd, const struct sockaddr_in& addr, const ServerConfig &config);
+		Client(int fd, const struct sockaddr_in& addr, Routing &routing,
+			const std::string &listener);
 		~Client();
 
 		bool handleClientRequest();
 		bool handleClientResponse();
 		void closeClient();
+		void markClosed();
+
+		// Event loop integration: the socket plus any CGI pipes, with the
+		// events this client is currently interested in
+		void collectPollFds(std::vector<struct pollfd> &fds) const;
+		void handleCgiEvent(int fd, short revents);
+		void handleChildExit(pid_t pid, int status);
+		// Enforces CGI timeouts and finishes a CGI request that ended without
+		// an fd event, such as one that timed out waiting for a slot
+		void checkCgi(time_t now);
+		bool isExpired(time_t now) const;
 
 		int getFd() const;
 		const std::string& getClientAddress() const;
 		bool isClientClosed() const;
 
 	private:
+		enum State
+		{
+			READING_HEADERS,
+			READING_BODY
+		};
+
 		int _fd;
 		bool _closed;
+		bool _closeAfterWrite;
+		bool _lingering;
+		time_t _lingerDeadline;
+		size_t _lingerBytes;
 		std::string _readBuffer;
 		std::string _writeBuffer;
 		std::string _clientAddress;
 
 		Request *_request;
 		Response _response;
-		const ServerConfig &_config;
+		// The configuration this connection's requests are routed with, and
+		// the server blocks in it sharing the listener it came in on
+		Routing *_routing;
+		std::string _listener;
+		const VirtualHosts *_hosts;
+		// The server block chosen by the current request's Host header
+		const ServerConfig *_config;
+		CgiHandler *_cgi;
+		// Body of the current response when it is sent straight from a file
+		FileBody _file;
+
+		State _state;
+		size_t _headerScanPos;
+		size_t _bodyRemaining;
+		bool _discardBody;
+		ChunkedDecoder _chunkedDecoder;
 
-		bool _hasCompleteRequest() const;
+		void _processReadBuffer();
+		bool _parseHeaders(size_t &offset);
+		bool _readBody(size_t &offset);
+		bool _appendBody(const char *data, size_t len);
+		void _dispatchRequest();
+		void _finishCgi();
+		void _rejectRequest(int code);
+		void _refuseRequest(Response &response);
+		bool _expectsContinue() const;
+		void _resetRequest();
+		void _followReload();
+		bool _linger();
 };
@@ -23,7 +23,7 @@ ClientManager::ClientManager(){}
 
 ClientManager::~ClientManager(){}
 
-int ClientManager::acceptNewClient(int serverFd, const ServerConfig &config)
+int ClientManager::acceptNewClient(int serverFd, Routing &routing, const std::string &address)
 {
 	struct sockaddr_in clientAddr;
 	socklen_t clientAddrSize = sizeof(clientAddr);
@@ -48,20 +48,51 @@ int ClientManager::acceptNewClient(int serverFd, const ServerConfig &config)
 		return -1;
 	}
 
-	Client* client = new Client(clientFd, clientAddr, config);
+	// CGI children must not keep client connections open behind our back
+	fcntl(clientFd, F_SETFD, FD_CLOEXEC);
+
+	Client* client = new Client(clientFd, clientAddr, routing, address);
 	_clients[clientFd] = client;
 
 	Logger::info("Client connected: " + intToString(clientFd));
 	return clientFd;
 }
 
+void ClientManager::collectPollFds(std::vector<struct pollfd> &fds)
+{
+	_cgiFds.clear();
+	for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+	{
+		if (it->second->isClientClosed())
+			continue;
+
+		size_t first = fds.size();
+		it->second->collectPollFds(fds);
+
+		// Everything after the socket itself belongs to the client's CGI
+		for (size_t i = first + 1; i < fds.size(); ++i)
+			_cgiFds[fds[i].fd] = it->second;
+	}
+}
+
 bool ClientManager::handleClientIO(int fd, short revents)
 {
-	if (_clients.find(fd) == _clients.end()) {
-		return false;
+	std::map<int, Client*>::iterator it = _clients.find(fd);
+	if (it == _clients.end()) {
+		std::map<int, Client*>::iterator cgi = _cgiFds.find(fd);
+		if (cgi == _cgiFds.end()) {
+			return false;
+		}
+		if (!cgi->second->isClientClosed()) {
+			cgi->second->handleCgiEvent(fd, revents);
+		}
+		return true;
 	}
 
-	Client* client = _clients[fd];
+	Client* client = it->second;
+	if (client->isClientClosed()) {
+		return false;
+	}
 
 	bool keepConnection = true;
 
@@ -90,9 +121,41 @@ bool ClientManager::handleClientIO(int fd, short revents)
 		keepConnection = false; // Error condition, mark for closure
 	}
 
+	// Closing is deferred to the end of the loop iteration, so the fd number
+	// cannot be reused while stale poll entries still refer to it
+	if (!keepConnection) {
+		client->markClosed();
+		_closing.push_back(fd);
+	}
 	return keepConnection;
 }
 
+void ClientManager::handleChildExit(pid_t pid, int status)
+{
+	for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+		it->second->handleChildExit(pid, status);
+}
+
+void ClientManager::checkTimeouts(time_t now)
+{
+	for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+	{
+		if (!it->second->isClientClosed())
+			it->second->checkCgi(now);
+		if (!it->second->isClientClosed() && it->second->isExpired(now)) {
+			it->second->markClosed();
+			_closing.push_back(it->first);
+		}
+	}
+}
+
+void ClientManager::removeClosedClients()
+{
+	for (size_t i = 0; i < _closing.size(); ++i)
+		removeClient(_closing[i]);
+	_closing.clear();
+}
+
 void ClientManager::removeClient(int fd)
 {
 	if (_clients.find(fd) != _clients.end()) {
@@ -112,6 +175,11 @@ Client *ClientManager::getClient(int fd) const
 	return NULL;
 }
 
+bool ClientManager::empty() const
+{
+	return _clients.empty();
+}
+
 void ClientManager::cleanup()
 {
 	for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it)
@@ -120,5 +188,7 @@ void ClientManager::cleanup()
 		close(it->first);
 	}
 	_clients.clear();
+	_cgiFds.clear();
+	_closing.clear();
 	Logger::info("All clients cleaned up.");
 }
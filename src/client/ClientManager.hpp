@@ -20,16 +20,24 @@ class ClientManager
 		ClientManager();
 		~ClientManager();
 
-		int acceptNewClient(int serverFd, const ServerConfig &config);
+		// `address` is the listener's, looked up in `routing` for each request
+		int acceptNewClient(int serverFd, Routing &routing, const std::string &address);
+		void collectPollFds(std::vector<struct pollfd> &fds);
 		bool handleClientIO(int fd, short revents);
+		void handleChildExit(pid_t pid, int status);
+		void checkTimeouts(time_t now);
+		void removeClosedClients();
 		void removeClient(int fd);
 
 		Client *getClient(int fd) const;
+		bool empty() const;
 
 		void cleanup();
 
 	private:
 		std::map<int, Client *> _clients;
+		std::map<int, Client *> _cgiFds;
+		std::vector<int> _closing;
 
 };
 
@@ -0,0 +1,153 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ConfigLexer.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:40:12 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:40:12 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ConfigLexer.hpp"
+
+static bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+ConfigLexer::ConfigLexer(const std::string& source) :
+	_source(source),
+	_pos(0),
+	_line(1)
+{}
+
+bool ConfigLexer::next(Statement& statement)
+{
+	_skipBlank();
+	if (_pos >= _source.size())
+		return false;
+
+	statement.line = _line;
+	statement.name.clear();
+	statement.args.clear();
+	statement.kind = DIRECTIVE;
+
+	char c = _source[_pos];
+	if (c == '{' || c == '}')
+	{
+		++_pos;
+		statement.kind = (c == '{') ? BLOCK : BLOCK_END;
+		return true;
+	}
+
+	size_t start = _pos;
+	while (_pos < _source.size() && !isBlank(c = _source[_pos])
+		&& c != '\n' && c != ';' && c != '{')
+		++_pos;
+	statement.name.assign(_source, start, _pos - start);
+
+	size_t argsStart = std::string::npos;
+	size_t argsEnd = std::string::npos;
+	while (_pos < _source.size())
+	{
+		c = _source[_pos];
+		if (isBlank(c))
+			++_pos;
+		else if (c == '#')
+			_skipComment();
+		else if (c == ';')
+		{
+			++_pos;
+			break;
+		}
+		else if (c == '{')
+		{
+			++_pos;
+			statement.kind = BLOCK;
+			break;
+		}
+		else if (c == '}')
+			// Closes the enclosing block; returned by the next call
+			break;
+		else if (c == '\n')
+		{
+			if (_atBlockOpen())
+				statement.kind = BLOCK;
+			break;
+		}
+		else
+		{
+			if (argsStart == std::string::npos)
+				argsStart = _pos;
+			argsEnd = _scanWord();
+		}
+	}
+	if (argsStart != std::string::npos)
+		statement.args.assign(_source, argsStart, argsEnd - argsStart);
+	return true;
+}
+
+// Whitespace, newlines, comments and empty statements
+void ConfigLexer::_skipBlank()
+{
+	while (_pos < _source.size())
+	{
+		char c = _source[_pos];
+		if (c == '\n')
+		{
+			++_line;
+			++_pos;
+		}
+		else if (isBlank(c) || c == ';')
+			++_pos;
+		else if (c == '#')
+			_skipComment();
+		else
+			break;
+	}
+}
+
+void ConfigLexer::_skipComment()
+{
+	while (_pos < _source.size() && _source[_pos] != '\n')
+		++_pos;
+}
+
+// A statement ended by a newline still opens a block when the next thing
+// after it is a '{'
+bool ConfigLexer::_atBlockOpen()
+{
+	while (_pos < _source.size())
+	{
+		char c = _source[_pos];
+		if (c == '\n')
+		{
+			++_line;
+			++_pos;
+		}
+		else if (isBlank(c))
+			++_pos;
+		else if (c == '#')
+			_skipComment();
+		else
+			break;
+	}
+	if (_pos < _source.size() && _source[_pos] == '{')
+	{
+		++_pos;
+		return true;
+	}
+	return false;
+}
+
+// Returns the end of the argument starting at the current position
+size_t ConfigLexer::_scanWord()
+{
+	char c;
+	while (_pos < _source.size() && !isBlank(c = _source[_pos])
+		&& c != '\n' && c != ';')
+		++_pos;
+	return _pos;
+}
@@ -0,0 +1,56 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ConfigLexer.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:40:12 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:40:12 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+
+// Splits a configuration file into statements in one pass over the buffer.
+// A statement is a directive name and its arguments, ended by ';', a newline
+// or a '{' that opens a block; a lone '}' closes one. '#' starts a comment,
+// and a '{' on the line after a statement still opens its block. Braces
+// inside an argument, as in a regex, are kept as part of it.
+class ConfigLexer
+{
+	public:
+		enum Kind
+		{
+			DIRECTIVE,
+			BLOCK,
+			BLOCK_END
+		};
+
+		struct Statement
+		{
+			Kind kind;
+			std::string name;
+			// The arguments as written, without the terminator
+			std::string args;
+			int line;
+		};
+
+		// `source` must outlive the lexer
+		explicit ConfigLexer(const std::string& source);
+
+		// False once the input is exhausted
+		bool next(Statement& statement);
+
+	private:
+		const std::string& _source;
+		size_t _pos;
+		int _line;
+
+		void _skipBlank();
+		void _skipComment();
+		bool _atBlockOpen();
+		size_t _scanWord();
+};
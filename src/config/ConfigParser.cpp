@@ -12,29 +12,64 @@
 
 #include "ConfigParser.hpp"
 
-ConfigParser::ConfigParser(const std::string& path) : _path(path)
+// An include that includes itself stops here instead of recursing forever
+static const int MAX_INCLUDE_DEPTH = 8;
+
+ConfigParser::ConfigParser(const std::string& path) :
+	_path(path),
+	_hasTypes(false),
+	_includeDepth(0)
 {
 	_initHandlers();
 }
 
-std::vector<ServerConfig> ConfigParser::parse()
+void ConfigParser::parse(std::deque<ServerConfig>& servers)
 {
-	std::string content = _readFile();
-	std::istringstream stream(content);
-	return _parseConfig(stream);
+	std::string content = _readFile(_path);
+	ConfigLexer lexer(content);
+	_parseTopLevel(lexer, servers);
+
+	// Types and error pages are final only once the whole file is read
+	for (size_t i = 0; i < servers.size(); ++i)
+	{
+		if (_hasTypes && servers[i].getMimeTypes().isBuiltin())
+			servers[i].setMimeTypes(_types);
+		servers[i].prepareResponses();
+		servers[i].compileRoutes();
+	}
 }
 
-std::string ConfigParser::_readFile()
+std::string ConfigParser::_readFile(const std::string& path)
 {
-	std::ifstream file(_path.c_str());
+	std::ifstream file(path.c_str(), std::ios::binary);
 	if (!file.is_open())
 	{
-		throw std::runtime_error("Failed to open config file: " + _path);
+		throw std::runtime_error("Failed to open config file: " + path);
 	}
 
-	std::stringstream buffer;
-	buffer << file.rdbuf();
-	return buffer.str();
+	file.seekg(0, std::ios::end);
+	std::streamoff size = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	std::string content(size > 0 ? static_cast<size_t>(size) : 0, '\0');
+	if (size > 0 && !file.read(&content[0], size))
+		throw std::runtime_error("Failed to read config file: " + path);
+	return content;
+}
+
+// Included paths are relative to the directory of the main config file
+std::string ConfigParser::_readInclude(const std::string& args, int lineNum)
+{
+	const std::string& path = args;
+	if (path.empty() || path.find_first_of(" \t") != std::string::npos)
+		_throwError(lineNum, "Invalid include syntax");
+	if (_includeDepth >= MAX_INCLUDE_DEPTH)
+		_throwError(lineNum, "Includes nested too deeply: " + path);
+
+	size_t slash = _path.rfind('/');
+	if (path[0] != '/' && slash != std::string::npos)
+		return _readFile(_path.substr(0, slash + 1) + path);
+	return _readFile(path);
 }
 
 void ConfigParser::_initHandlers()
@@ -46,23 +81,32 @@ void ConfigParser::_initHandlers()
 	_serverHandlers["error_page"] = &ConfigParser::_handleErrorPage;
 	_serverHandlers["client_max_body_size"] =
 		&ConfigParser::_handleClientMaxBodySize;
+	_serverHandlers["client_body_buffer_size"] =
+		&ConfigParser::_handleClientBodyBufferSize;
 	_serverHandlers["autoindex"] = &ConfigParser::_handleServerAutoIndex;
+	_serverHandlers["rewrite"] = &ConfigParser::_handleRewrite;
 
 	_locationHandlers["root"] = &ConfigParser::_handleLocRoot;
 	_locationHandlers["index"] = &ConfigParser::_handleLocIndex;
 	_locationHandlers["autoindex"] = &ConfigParser::_handleAutoIndex;
+	_locationHandlers["autoindex_format"] = &ConfigParser::_handleAutoIndexFormat;
 	_locationHandlers["allow_methods"] = &ConfigParser::_handleAllowMethods;
 	_locationHandlers["return"] = &ConfigParser::_handleLocReturn;
+	_locationHandlers["rewrite"] = &ConfigParser::_handleLocRewrite;
 	_locationHandlers["cgi"] = &ConfigParser::_handleCgi;
-}
-
-std::string ConfigParser::trim(const std::string &s)
-{
-	size_t first = s.find_first_not_of(" \t\r\n;");
-	size_t last = s.find_last_not_of(" \t\r\n;");
-	if (first == std::string::npos || last == std::string::npos)
-		return "";
-	return s.substr(first, last - first + 1);
+	_locationHandlers["fastcgi_pass"] = &ConfigParser::_handleFastCgiPass;
+	_locationHandlers["cgi_pool"] = &ConfigParser::_handleCgiPool;
+	_locationHandlers["cgi_max_concurrent"] = &ConfigParser::_handleCgiMaxConcurrent;
+	_locationHandlers["cgi_queue_size"] = &ConfigParser::_handleCgiQueueSize;
+	_locationHandlers["cgi_timeout"] = &ConfigParser::_handleCgiTimeout;
+	_locationHandlers["cgi_rlimit_cpu"] = &ConfigParser::_handleCgiRlimitCpu;
+	_locationHandlers["cgi_rlimit_as"] = &ConfigParser::_handleCgiRlimitAs;
+	_locationHandlers["cgi_cache"] = &ConfigParser::_handleCgiCache;
+	_locationHandlers["cgi_cache_key"] = &ConfigParser::_handleCgiCacheKey;
+	_locationHandlers["cgi_cache_max_size"] = &ConfigParser::_handleCgiCacheMaxSize;
+	_locationHandlers["cgi_splice"] = &ConfigParser::_handleCgiSplice;
+	_locationHandlers["metrics"] = &ConfigParser::_handleMetrics;
+	_locationHandlers["internal"] = &ConfigParser::_handleInternal;
 }
 
 std::string ConfigParser::intToString(int v)
@@ -77,116 +121,131 @@ void ConfigParser::_throwError(int lineNum, const std::string& msg) const
 	throw std::runtime_error("Line " + intToString(lineNum) + ": " + msg);
 }
 
-std::vector<ServerConfig> ConfigParser::_parseConfig(std::istringstream& stream)
+void ConfigParser::_parseTopLevel(ConfigLexer& lexer, std::deque<ServerConfig>& servers)
 {
-	std::map<ServerKey, ServerConfig> serverMap;
-	std::string line;
-	int lineNum = 0;
+	ConfigLexer::Statement statement;
 
-	while (std::getline(stream, line))
+	while (lexer.next(statement))
 	{
-		++lineNum;
-		std::string trimmed = trim(line);
-		if (trimmed.empty() || trimmed[0] == '#')
-			continue;
-
-		std::istringstream iss(trimmed);
-		std::string token;
-		iss >> token;
-		if (token == "server")
+		if (statement.kind == ConfigLexer::BLOCK_END)
+			_throwError(statement.line, "Unexpected '}'");
+
+		if (statement.name == "server")
+		{
+			if (statement.kind != ConfigLexer::BLOCK)
+				_throwError(statement.line, "Expected '{' after server");
+			_parseServerBlock(lexer, statement.line, servers);
+		}
+		else if (statement.name == "types")
 		{
-			_parseServerBlock(trimmed, lineNum, stream, serverMap);
+			_parseTypesBlock(lexer, statement, _types);
+			_hasTypes = true;
+		}
+		else if (statement.name == "include")
+		{
+			std::string content = _readInclude(statement.args, statement.line);
+			ConfigLexer included(content);
+			++_includeDepth;
+			_parseTopLevel(included, servers);
+			--_includeDepth;
 		}
 		else
 		{
-			_throwError(lineNum, "Unexpected token '" + token + "'");
+			_throwError(statement.line, "Unexpected token '" + statement.name + "'");
 		}
 	}
-
-	std::vector<ServerConfig> servers;
-	for (std::map<ServerKey, ServerConfig>::iterator it = serverMap.begin();
-		it != serverMap.end(); ++it)
-	{
-		servers.push_back(it->second);
-	}
-	return servers;
 }
 
-bool ConfigParser::_findOpeningBrace(const std::string& firstLine, int& lineNum,
-									std::istringstream& stream,
-									const std::string& context)
+// types { text/html html htm; image/png png; ... }
+void ConfigParser::_parseTypesBlock(ConfigLexer& lexer,
+									const ConfigLexer::Statement& opening,
+									MimeTypes& types)
 {
-	std::istringstream iline(firstLine);
-	std::string token;
-
-	// Skip past the directive name and check for brace on same line
-	while (iline >> token && token != "{")
-		;
-
-	if (token == "{")
-		return true;
+	if (opening.kind != ConfigLexer::BLOCK)
+		_throwError(opening.line, "Expected '{' after types");
 
-	// Look for brace on next non-empty, non-comment line
-	std::string nextLine;
-	while (std::getline(stream, nextLine))
+	MimeTypes::Table table;
+	ConfigLexer::Statement statement;
+	while (lexer.next(statement))
 	{
-		++lineNum;
-		std::string trimmed = trim(nextLine);
-
-		if (trimmed.empty() || trimmed[0] == '#')
-			continue;
-
-		if (trimmed == "{")
-			return true;
-
-		_throwError(lineNum, "Expected '{' after " + context + ", found: " + trimmed);
+		if (statement.kind == ConfigLexer::BLOCK_END)
+		{
+			types = MimeTypes(table);
+			return;
+		}
+		if (statement.kind == ConfigLexer::BLOCK)
+			_throwError(statement.line, "Unexpected block in types");
+
+		std::istringstream ss(statement.args);
+		std::string extension;
+		if (!(ss >> extension))
+			_throwError(statement.line, "MIME type '" + statement.name + "' has no extensions");
+		do
+			MimeTypes::add(table, statement.name, extension);
+		while (ss >> extension);
 	}
-
-	_throwError(lineNum, "Expected '{' after " + context);
-	return false;
+	_throwError(opening.line, "Unexpected end of types block");
 }
 
-void ConfigParser::_parseServerBlock(const std::string& firstLine, int& lineNum,
-									std::istringstream& stream,
-									std::map<ServerKey, ServerConfig>& servers)
+// The server is built where it is stored, so it is never copied
+void ConfigParser::_parseServerBlock(ConfigLexer& lexer, int lineNum,
+									std::deque<ServerConfig>& servers)
 {
-	if (!_findOpeningBrace(firstLine, lineNum, stream, "server"))
-		return;
+	servers.push_back(ServerConfig());
+	ServerConfig& config = servers.back();
 
-	ServerConfig currentConfig;
-	int braceCount = 1;
-	std::string rawLine;
+	if (!_parseServerBody(lexer, config))
+		_throwError(lineNum, "Unexpected end of server block");
+	_finalizeServerBlock(lineNum, config);
+}
 
-	while (braceCount > 0 && std::getline(stream, rawLine))
+// Reads server directives up to the '}' that closes the block, returning
+// true, or to the end of the input (an included file), returning false
+bool ConfigParser::_parseServerBody(ConfigLexer& lexer, ServerConfig& config)
+{
+	ConfigLexer::Statement statement;
+
+	while (lexer.next(statement))
 	{
-		++lineNum;
-		std::string line = trim(rawLine);
-		if (line.empty() || line[0] == '#')
-			continue;
-
-		if (line == "{")
-			++braceCount;
-		else if (line == "}")
+		if (statement.kind == ConfigLexer::BLOCK_END)
+			return true;
+
+		if (statement.name == "location")
+		{
+			_parseLocationBlock(lexer, statement, config);
+		}
+		else if (statement.name == "types")
 		{
-			--braceCount;
-			if (braceCount == 0)
-			{
-				_finalizeServerBlock(lineNum, currentConfig, servers);
-				return;
-			}
+			MimeTypes types;
+			_parseTypesBlock(lexer, statement, types);
+			config.setMimeTypes(types);
+		}
+		else if (statement.kind == ConfigLexer::BLOCK)
+		{
+			_throwError(statement.line, "Unexpected block '" + statement.name + "' in server block");
+		}
+		else if (statement.name == "include")
+		{
+			// The included file's directives are read as if they were here
+			std::string content = _readInclude(statement.args, statement.line);
+			ConfigLexer included(content);
+			++_includeDepth;
+			if (_parseServerBody(included, config))
+				_throwError(statement.line, "Unexpected '}' in " + statement.args);
+			--_includeDepth;
 		}
 		else
 		{
-			_processServerLine(line, lineNum, stream, currentConfig);
+			ServerHandlerMap::iterator it = _serverHandlers.find(statement.name);
+			if (it == _serverHandlers.end())
+				_throwError(statement.line, "Unknown directive '" + statement.name + "' in server block");
+			(this->*(it->second))(statement.args, config, statement.line);
 		}
 	}
-
-	if (braceCount != 0)
-		_throwError(lineNum, "Unexpected end of server block");
+	return false;
 }
 
-void ConfigParser::_finalizeServerBlock(int lineNum, ServerConfig& currentConfig,
-										std::map<ServerKey, ServerConfig>& servers)
+void ConfigParser::_finalizeServerBlock(int lineNum, ServerConfig& currentConfig)
 {
 	_validateServerBlock(currentConfig, lineNum);
 	if (currentConfig.getListens().empty())
@@ -199,119 +258,76 @@ void ConfigParser::_finalizeServerBlock(int lineNum, ServerConfig& currentConfig
 	key.host = firstListen.getIp();
 	key.port = firstListen.getPort();
 
-	std::vector<std::string> serverNames = currentConfig.getServerNames();
+	const std::vector<std::string>& serverNames = currentConfig.getServerNames();
 	key.names.insert(serverNames.begin(), serverNames.end());
 
-	if (servers.find(key) != servers.end())
+	if (!_serverKeys.insert(key).second)
 		_throwError(lineNum, "Duplicate server");
 
-	servers[key] = currentConfig;
+	currentConfig.prepareLocations();
 }
 
-void ConfigParser::_processServerLine(const std::string& line, int lineNum,
-									std::istringstream& stream,
-									ServerConfig& currentConfig)
+void ConfigParser::_parseLocationBlock(ConfigLexer& lexer,
+										const ConfigLexer::Statement& opening,
+										ServerConfig& currentConfig)
 {
-	std::istringstream ls(line);
-	std::string key;
-	ls >> key;
-	std::string remainder;
-	std::getline(ls, remainder);
-	remainder = trim(remainder);
+	std::istringstream iline(opening.args);
+	std::string path;
+	iline >> path;
 
-	ServerHandlerMap::iterator it = _serverHandlers.find(key);
-	if (it != _serverHandlers.end())
+	LocationConfig::Modifier modifier = LocationConfig::MATCH_PREFIX;
+	if (path == "=")
+		modifier = LocationConfig::MATCH_EXACT;
+	else if (path == "^~")
+		modifier = LocationConfig::MATCH_PREFIX_ONLY;
+	else if (path == "~")
+		modifier = LocationConfig::MATCH_REGEX;
+	if (modifier != LocationConfig::MATCH_PREFIX)
 	{
-		(this->*(it->second))(remainder, currentConfig, lineNum);
+		path.clear();
+		iline >> path;
 	}
-	else if (key == "location")
-	{
-		_parseLocationBlock(line, lineNum, stream, currentConfig);
-	}
-	else
-	{
-		_throwError(lineNum, "Unknown directive '" + key + "' in server block");
-	}
-}
-
-void ConfigParser::_parseLocationBlock(const std::string& firstLine, int& lineNum,
-										std::istringstream& stream,
-										ServerConfig& currentConfig)
-{
-	std::istringstream iline(firstLine);
-	std::string keyword, path, brace;
-
-	iline >> keyword;
-	iline >> path;
-	iline >> brace;
 
 	if (path.empty())
-		_throwError(lineNum, "Location directive requires a path argument");
+		_throwError(opening.line, "Location directive requires a path argument");
+	if (opening.kind != ConfigLexer::BLOCK)
+		_throwError(opening.line, "Expected '{' after location " + path);
 
-	// Use the enhanced brace finding method
-	if (!_findOpeningBrace(firstLine, lineNum, stream, "location " + path))
-		return;
+	LocationConfig& loc = currentConfig.addLocation(modifier, path);
+	ConfigLexer::Statement statement;
 
-	LocationConfig loc;
-	loc.setPath(path);
-	int braceCount = 1;
-	std::string rawLine;
-
-	while (braceCount > 0 && std::getline(stream, rawLine))
+	while (lexer.next(statement))
 	{
-		++lineNum;
-		std::string line = trim(rawLine);
-		if (line.empty() || line[0] == '#')
-			continue;
-
-		if (line == "{")
-			++braceCount;
-		else if (line == "}")
-		{
-			--braceCount;
-			if (braceCount == 0)
-			{
-				currentConfig.addLocation(loc);
-				return;
-			}
-		}
-		else
-		{
-			_processLocationLine(line, lineNum, stream, loc);
-		}
+		if (statement.kind == ConfigLexer::BLOCK_END)
+			return;
+		if (statement.kind == ConfigLexer::BLOCK)
+			_throwError(statement.line, "Unexpected block '" + statement.name + "' in location block");
+
+		LocationHandlerMap::iterator it = _locationHandlers.find(statement.name);
+		if (it == _locationHandlers.end())
+			_throwError(statement.line, "Unknown directive '" + statement.name + "' in location block");
+		(this->*(it->second))(statement.args, loc, statement.line);
 	}
-
-	if (braceCount != 0)
-		_throwError(lineNum, "Unexpected end of location block");
+	_throwError(opening.line, "Unexpected end of location block");
 }
 
-void ConfigParser::_processLocationLine(const std::string& line, int lineNum,
-										std::istringstream& stream,
-										LocationConfig& loc)
+void ConfigParser::_handleListen(const std::string& args,
+								ServerConfig& cfg, int lineNum)
 {
-	(void)stream;
-	std::istringstream ls(line);
-	std::string key;
-	ls >> key;
-	std::string remainder;
-	std::getline(ls, remainder);
-	remainder = trim(remainder);
+	std::istringstream ss(args);
+	std::string address, flag;
 
-	LocationHandlerMap::iterator it = _locationHandlers.find(key);
-	if (it != _locationHandlers.end())
-	{
-		(this->*(it->second))(remainder, loc, lineNum);
-	}
-	else
+	if (!(ss >> address))
+		_throwError(lineNum, "Invalid listen syntax");
+
+	bool defaultServer = false;
+	while (ss >> flag)
 	{
-		_throwError(lineNum, "Unknown directive '" + key + "' in location block");
+		if (flag != "default_server")
+			_throwError(lineNum, "Unknown listen parameter '" + flag + "'");
+		defaultServer = true;
 	}
-}
-
-void ConfigParser::_handleListen(const std::string& args,
-								ServerConfig& cfg, int /* lineNum */)
-{
-	cfg.addListen(trim(args));
+	cfg.addListen(address, defaultServer);
 }
 
 void ConfigParser::_handleServerName(const std::string& args,
@@ -320,10 +336,11 @@ void ConfigParser::_handleServerName(const std::string& args,
 	std::istringstream ss(args);
 	std::string name;
 
-	if (ss >> name)
-		cfg.addServerName(name);
-	else
+	if (!(ss >> name))
 		_throwError(lineNum, "Invalid server_name syntax");
+	do
+		cfg.addServerName(name);
+	while (ss >> name);
 }
 
 void ConfigParser::_handleRoot(const std::string& args,
@@ -371,6 +388,15 @@ void ConfigParser::_handleServerAutoIndex(const std::string &args,
 		_throwError(lineNum, "Invalid autoindex value in server");
 }
 
+void ConfigParser::_handleRewrite(const std::string& args,
+								ServerConfig& cfg, int lineNum)
+{
+	std::string pattern, replacement;
+	RewriteProgram::Flag flag;
+	_parseRewrite(args, lineNum, pattern, replacement, flag);
+	cfg.addRewrite(pattern, replacement, flag);
+}
+
 void ConfigParser::_handleClientMaxBodySize(const std::string& args,
 									ServerConfig& cfg, int lineNum)
 {
@@ -382,6 +408,17 @@ void ConfigParser::_handleClientMaxBodySize(const std::string& args,
 	cfg.setClientMaxBodySize(sz);
 }
 
+// client_body_buffer_size <size>: bodies larger than this are spooled to a
+// temporary file instead of being held in memory
+void ConfigParser::_handleClientBodyBufferSize(const std::string& args,
+										ServerConfig& cfg, int lineNum)
+{
+	size_t bytes;
+	if (!_parseSize(args, bytes))
+		_throwError(lineNum, "Invalid client_body_buffer_size");
+	cfg.setClientBodyBufferSize(bytes);
+}
+
 void ConfigParser::_handleLocRoot(const std::string& args,
 								LocationConfig& loc, int lineNum)
 {
@@ -409,6 +446,17 @@ void ConfigParser::_handleAutoIndex(const std::string& args,
 		_throwError(lineNum, "Invalid autoindex value");
 }
 
+void ConfigParser::_handleAutoIndexFormat(const std::string& args,
+										LocationConfig& loc, int lineNum)
+{
+	if (args == "html")
+		loc.setAutoIndexFormat(LocationConfig::AUTOINDEX_HTML);
+	else if (args == "json")
+		loc.setAutoIndexFormat(LocationConfig::AUTOINDEX_JSON);
+	else
+		_throwError(lineNum, "Invalid autoindex_format value");
+}
+
 void ConfigParser::_handleAllowMethods(const std::string& args,
 									LocationConfig& loc, int lineNum)
 {
@@ -433,6 +481,32 @@ void ConfigParser::_handleLocReturn(const std::string& args,
 	loc.addRedirect(code, target);
 }
 
+void ConfigParser::_handleLocRewrite(const std::string& args,
+									LocationConfig& loc, int lineNum)
+{
+	std::string pattern, replacement;
+	RewriteProgram::Flag flag;
+	_parseRewrite(args, lineNum, pattern, replacement, flag);
+	loc.addRewrite(pattern, replacement, flag);
+}
+
+// rewrite <regex> <replacement> [last|break|redirect|permanent]
+void ConfigParser::_parseRewrite(const std::string& args, int lineNum, std::string& pattern,
+								std::string& replacement, RewriteProgram::Flag& flag) const
+{
+	std::istringstream ss(args);
+	std::string flagName;
+
+	if (!(ss >> pattern >> replacement))
+		_throwError(lineNum, "Invalid rewrite syntax");
+
+	flag = RewriteProgram::FLAG_NONE;
+	if (ss >> flagName && !RewriteProgram::parseFlag(flagName, flag))
+		_throwError(lineNum, "Unknown rewrite flag '" + flagName + "'");
+	if (ss >> flagName)
+		_throwError(lineNum, "Invalid rewrite syntax");
+}
+
 void ConfigParser::_handleCgi(const std::string& args,
 							LocationConfig& loc, int lineNum)
 {
@@ -451,6 +525,179 @@ void ConfigParser::_handleCgi(const std::string& args,
 	loc.addCgi(ext, cgiPath);
 }
 
+void ConfigParser::_handleFastCgiPass(const std::string& args,
+									LocationConfig& loc, int lineNum)
+{
+	std::istringstream ss(args);
+	std::string address, extra;
+	ss >> address;
+	if (address.empty() || (ss >> extra))
+		_throwError(lineNum, "fastcgi_pass expects exactly one address");
+	loc.setFastCgiPass(address);
+}
+
+// cgi_pool <workers> [max_requests]; max_requests 0 never recycles
+void ConfigParser::_handleCgiPool(const std::string& args,
+								LocationConfig& loc, int lineNum)
+{
+	std::istringstream ss(args);
+	long workers = 0;
+	long maxRequests = 0;
+	ss >> workers;
+	if (ss.fail())
+		_throwError(lineNum, "cgi_pool expects a worker count");
+	if (!ss.eof() && !(ss >> maxRequests))
+		_throwError(lineNum, "Invalid cgi_pool max_requests");
+	if (!ss.eof() || workers < 1 || maxRequests < 0)
+		_throwError(lineNum, "Invalid cgi_pool syntax");
+	loc.setCgiPool(workers, maxRequests);
+}
+
+void ConfigParser::_handleCgiMaxConcurrent(const std::string& args,
+										LocationConfig& loc, int lineNum)
+{
+	std::istringstream ss(args);
+	long limit = 0;
+	ss >> limit;
+	if (ss.fail() || !ss.eof() || limit < 1)
+		_throwError(lineNum, "Invalid cgi_max_concurrent value");
+	loc.setCgiMaxConcurrent(limit);
+}
+
+// cgi_queue_size <size> [timeout_seconds]; requests waiting longer get a 503
+void ConfigParser::_handleCgiQueueSize(const std::string& args,
+									LocationConfig& loc, int lineNum)
+{
+	std::istringstream ss(args);
+	long size = -1;
+	long timeout = loc.getCgiQueueTimeout();
+	ss >> size;
+	if (ss.fail())
+		_throwError(lineNum, "cgi_queue_size expects a queue length");
+	if (!ss.eof() && !(ss >> timeout))
+		_throwError(lineNum, "Invalid cgi_queue_size timeout");
+	if (!ss.eof() || size < 0 || timeout < 1)
+		_throwError(lineNum, "Invalid cgi_queue_size syntax");
+	loc.setCgiQueue(size, timeout);
+}
+
+void ConfigParser::_handleCgiTimeout(const std::string& args,
+									LocationConfig& loc, int lineNum)
+{
+	std::istringstream ss(args);
+	long seconds = 0;
+	ss >> seconds;
+	if (ss.fail() || !ss.eof() || seconds < 1)
+		_throwError(lineNum, "Invalid cgi_timeout value");
+	loc.setCgiTimeout(seconds);
+}
+
+void ConfigParser::_handleCgiRlimitCpu(const std::string& args,
+									LocationConfig& loc, int lineNum)
+{
+	std::istringstream ss(args);
+	long seconds = 0;
+	ss >> seconds;
+	if (ss.fail() || !ss.eof() || seconds < 1)
+		_throwError(lineNum, "Invalid cgi_rlimit_cpu value");
+	loc.setCgiRlimitCpu(seconds);
+}
+
+// cgi_rlimit_as <bytes>[k|m|g]
+void ConfigParser::_handleCgiRlimitAs(const std::string& args,
+									LocationConfig& loc, int lineNum)
+{
+	size_t bytes;
+	if (!_parseSize(args, bytes))
+		_throwError(lineNum, "Invalid cgi_rlimit_as value");
+	loc.setCgiRlimitAs(bytes);
+}
+
+// cgi_cache <ttl_seconds>
+void ConfigParser::_handleCgiCache(const std::string& args,
+								LocationConfig& loc, int lineNum)
+{
+	std::istringstream ss(args);
+	long ttl = 0;
+	ss >> ttl;
+	if (ss.fail() || !ss.eof() || ttl < 1)
+		_throwError(lineNum, "Invalid cgi_cache TTL");
+	loc.setCgiCache(ttl);
+}
+
+// cgi_cache_key <template>, e.g. $method|$host|$path|$query|$http_accept_language
+void ConfigParser::_handleCgiCacheKey(const std::string& args,
+									LocationConfig& loc, int lineNum)
+{
+	if (args.empty() || args.find_first_of(" \t") != std::string::npos)
+		_throwError(lineNum, "cgi_cache_key expects a single template");
+	loc.setCgiCacheKey(args);
+}
+
+void ConfigParser::_handleCgiCacheMaxSize(const std::string& args,
+										LocationConfig& loc, int lineNum)
+{
+	size_t bytes;
+	if (!_parseSize(args, bytes))
+		_throwError(lineNum, "Invalid cgi_cache_max_size value");
+	loc.setCgiCacheMaxSize(bytes);
+}
+
+// A byte count with an optional k, m or g suffix
+bool ConfigParser::_parseSize(const std::string& value, size_t& bytes)
+{
+	size_t digits = value.find_first_not_of("0123456789");
+	if (digits == std::string::npos)
+		digits = value.size();
+	if (digits == 0 || digits > 15)
+		return false;
+
+	bytes = std::strtoul(value.substr(0, digits).c_str(), NULL, 10);
+	if (digits == value.size())
+		return true;
+	if (digits + 1 != value.size())
+		return false;
+
+	switch (std::tolower(static_cast<unsigned char>(value[digits]))) {
+		case 'k': bytes <<= 10; return true;
+		case 'm': bytes <<= 20; return true;
+		case 'g': bytes <<= 30; return true;
+		default: return false;
+	}
+}
+
+// cgi_splice on|off: moves script output to the socket with splice(2)
+void ConfigParser::_handleCgiSplice(const std::string& args,
+								LocationConfig& loc, int lineNum)
+{
+	if (args == "on")
+		loc.setCgiSplice(true);
+	else if (args == "off")
+		loc.setCgiSplice(false);
+	else
+		_throwError(lineNum, "Invalid cgi_splice value");
+}
+
+void ConfigParser::_handleMetrics(const std::string& args,
+								LocationConfig& loc, int lineNum)
+{
+	if (args == "on")
+		loc.setMetrics(true);
+	else if (args == "off")
+		loc.setMetrics(false);
+	else
+		_throwError(lineNum, "Invalid metrics value");
+}
+
+// Internal locations only serve files CGI scripts point to with
+// X-Accel-Redirect or X-Sendfile; clients cannot request them directly
+void ConfigParser::_handleInternal(const std::string& args,
+								LocationConfig& loc, int lineNum)
+{
+	if (!args.empty())
+		_throwError(lineNum, "internal takes no arguments");
+	loc.setInternal(true);
+}
 
 void ConfigParser::_validateServerBlock(const ServerConfig& config, int lineNum)
 {
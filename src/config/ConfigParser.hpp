@@ -15,12 +15,16 @@
 #include "../../inc/webserv.hpp"
 #include "LocationConfig.hpp"
 #include "ServerConfig.hpp"
+#include "ConfigLexer.hpp"
+#include <deque>
 
 class ConfigParser
 {
 	public:
 		ConfigParser(const std::string& path);
-		std::vector<ServerConfig> parse();
+		// Appends the file's servers to `servers`, ready to serve: their
+		// routes are compiled where they are stored, which must not move
+		void parse(std::deque<ServerConfig>& servers);
 
 		// Public typedefs for handler maps
 		typedef void (ConfigParser::*ServerDirHandler)(const std::string& args,
@@ -48,29 +52,29 @@ class ConfigParser
 		};
 
 		std::string _path;
+		// Types from top-level "types" blocks and includes, given to every
+		// server that does not set its own
+		MimeTypes _types;
+		bool _hasTypes;
+		int _includeDepth;
+		// Servers are kept in file order, the first one on a listener being
+		// its default; this only catches blocks declared twice
+		std::set<ServerKey> _serverKeys;
 		ServerHandlerMap _serverHandlers;
 		LocationHandlerMap _locationHandlers;
 
-		std::string _readFile();
+		std::string _readFile(const std::string& path);
+		std::string _readInclude(const std::string& args, int lineNum);
 
-		std::vector<ServerConfig> _parseConfig(std::istringstream& stream);
-		bool _findOpeningBrace(const std::string& firstLine, int& lineNum,
-									std::istringstream& stream,
-									const std::string& context);
-		void _parseServerBlock(const std::string& firstLine, int& lineNum,
-							std::istringstream& stream,
-							std::map<ServerKey, ServerConfig>& servers);
-		void _parseLocationBlock(const std::string& firstLine, int& lineNum,
-								std::istringstream& stream,
+		void _parseTopLevel(ConfigLexer& lexer, std::deque<ServerConfig>& servers);
+		void _parseTypesBlock(ConfigLexer& lexer, const ConfigLexer::Statement& opening,
+							MimeTypes& types);
+		void _parseServerBlock(ConfigLexer& lexer, int lineNum,
+							std::deque<ServerConfig>& servers);
+		bool _parseServerBody(ConfigLexer& lexer, ServerConfig& config);
+		void _parseLocationBlock(ConfigLexer& lexer, const ConfigLexer::Statement& opening,
 								ServerConfig& currentConfig);
-		void _processServerLine(const std::string& line, int lineNum,
-							std::istringstream& stream,
-							ServerConfig& currentConfig);
-		void _processLocationLine(const std::string& line, int lineNum,
-								std::istringstream& stream,
-								LocationConfig& loc);
-		void _finalizeServerBlock(int lineNum, ServerConfig& currentConfig,
-								std::map<ServerKey, ServerConfig>& servers);
+		void _finalizeServerBlock(int lineNum, ServerConfig& currentConfig);
 		void _throwError(int lineNum, const std::string& msg) const;
 		void _validateServerBlock(const ServerConfig& config, int lineNum);
 
@@ -81,20 +85,39 @@ class ConfigParser
 		void _handleIndex(const std::string& args, ServerConfig& cfg, int lineNum);
 		void _handleErrorPage(const std::string& args, ServerConfig& cfg, int lineNum);
 		void _handleClientMaxBodySize(const std::string& args, ServerConfig& cfg, int lineNum);
+		void _handleClientBodyBufferSize(const std::string& args, ServerConfig& cfg, int lineNum);
 		void _handleServerAutoIndex(const std::string &args, ServerConfig &cfg, int lineNum);
+		void _handleRewrite(const std::string& args, ServerConfig& cfg, int lineNum);
 
 		// Location directive handlers
 		void _handleLocRoot(const std::string& args, LocationConfig& loc, int lineNum);
 		void _handleLocIndex(const std::string& args, LocationConfig& loc, int lineNum);
 		void _handleAutoIndex(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleAutoIndexFormat(const std::string& args, LocationConfig& loc, int lineNum);
 		void _handleAllowMethods(const std::string& args, LocationConfig& loc, int lineNum);
 		void _handleUploadDir(const std::string& args, LocationConfig& loc, int lineNum);
 		void _handleLocReturn(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleLocRewrite(const std::string& args, LocationConfig& loc, int lineNum);
 		void _handleCgi(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiPool(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiMaxConcurrent(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiQueueSize(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiTimeout(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiRlimitCpu(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiRlimitAs(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiCache(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiCacheKey(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiCacheMaxSize(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleCgiSplice(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleMetrics(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleInternal(const std::string& args, LocationConfig& loc, int lineNum);
+		void _handleFastCgiPass(const std::string& args, LocationConfig& loc, int lineNum);
 		void _handleLocAlias(const std::string& args, LocationConfig& loc, int lineNum);
 
 		// Helpers
 		void _initHandlers();
-		static std::string trim(const std::string& s);
 		static std::string intToString(int v);
+		static bool _parseSize(const std::string& value, size_t& bytes);
+		void _parseRewrite(const std::string& args, int lineNum, std::string& pattern,
+						std::string& replacement, RewriteProgram::Flag& flag) const;
 };
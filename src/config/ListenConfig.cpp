@@ -16,10 +16,11 @@
 ListenConfig::ListenConfig() :
 	_ip("0.0.0.0"),
 	_port(8080),
-	_ipPortJoin("0.0.0.0:8080")
+	_ipPortJoin("0.0.0.0:8080"),
+	_defaultServer(false)
 {}
 
-ListenConfig::ListenConfig(const std::string& token)
+ListenConfig::ListenConfig(const std::string& token) : _defaultServer(false)
 {
 	_parseToken(token);
 	_validatePort();
@@ -33,6 +34,8 @@ ListenConfig::ListenConfig(const std::string& token)
 const std::string& ListenConfig::getIp() const { return _ip; }
 unsigned int ListenConfig::getPort() const { return _port; }
 const std::string& ListenConfig::getIpPortJoin() const { return _ipPortJoin; }
+bool ListenConfig::isDefaultServer() const { return _defaultServer; }
+void ListenConfig::setDefaultServer(bool defaultServer) { _defaultServer = defaultServer; }
 
 void ListenConfig::_parseToken(const std::string& token)
 {
@@ -23,11 +23,14 @@ class ListenConfig
 		const std::string& getIp() const;
 		unsigned int getPort() const;
 		const std::string& getIpPortJoin() const;
+		bool isDefaultServer() const;
+		void setDefaultServer(bool defaultServer);
 
 	private:
 		std::string _ip;
 		unsigned int _port;
 		std::string _ipPortJoin;
+		bool _defaultServer;
 
 		void _parseToken(const std::string& token);
 		void _validateIp() const;
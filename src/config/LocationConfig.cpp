@@ -11,11 +11,31 @@
 /* ************************************************************************** */
 
 #include "LocationConfig.hpp"
+#include "ServerConfig.hpp"
+#include "RegexSet.hpp"
 
 LocationConfig::LocationConfig() :
 	_path(""),
+	_modifier(MATCH_PREFIX),
+	_order(0),
 	_root(""),
-	_autoindex(false)
+	_autoindex(false),
+	_autoindexFormat(AUTOINDEX_HTML),
+	_cgiPoolSize(0),
+	_cgiPoolMaxRequests(0),
+	_cgiMaxConcurrent(0),
+	_cgiQueueSize(0),
+	_cgiQueueTimeout(30),
+	_cgiTimeout(0),
+	_cgiRlimitCpu(0),
+	_cgiRlimitAs(0),
+	_cgiCacheTtl(0),
+	_cgiCacheKey("$method|$host|$path|$query"),
+	_cgiCacheMaxSize(16 * 1024 * 1024),
+	_cgiSplice(false),
+	_metrics(false),
+	_internal(false),
+	_methodMask(0)
 {}
 
 LocationConfig::~LocationConfig() {}
@@ -26,6 +46,11 @@ void LocationConfig::_validatePath(const std::string& path) const
 		throw std::runtime_error("Location path cannot be empty");
 	}
 
+	if (_modifier == MATCH_REGEX) {
+		RegexSet::validate(path);
+		return;
+	}
+
 	if (path[0] != '/') {
 		throw std::runtime_error("Location path must start with '/': " + path);
 	}
@@ -68,12 +93,45 @@ void LocationConfig::_validateStatusCode(int code) const
 	}
 }
 
+// Accepts "unix:/path/to/socket" or "host:port"
+void LocationConfig::_validateFastCgiAddress(const std::string& address) const
+{
+	if (address.compare(0, 5, "unix:") == 0) {
+		if (address.size() == 5) {
+			throw std::runtime_error("fastcgi_pass socket path cannot be empty");
+		}
+		return;
+	}
+
+	size_t colonPos = address.rfind(':');
+	if (colonPos == std::string::npos || colonPos == 0) {
+		throw std::runtime_error("fastcgi_pass expects unix:/path or host:port: " + address);
+	}
+
+	std::string port = address.substr(colonPos + 1);
+	int value = std::atoi(port.c_str());
+	if (port.empty() || port.find_first_not_of("0123456789") != std::string::npos
+		|| value < 1 || value > 65535) {
+		throw std::runtime_error("Invalid fastcgi_pass port: " + address);
+	}
+}
+
+void LocationConfig::setModifier(Modifier modifier)
+{
+	_modifier = modifier;
+}
+
 void LocationConfig::setPath(const std::string& p)
 {
 	_validatePath(p);
 	_path = p;
 }
 
+void LocationConfig::setOrder(size_t order)
+{
+	_order = order;
+}
+
 void LocationConfig::setRoot(const std::string& r)
 {
 	if (r.empty()) {
@@ -95,6 +153,11 @@ void LocationConfig::setAutoIndex(bool a)
 	_autoindex = a;
 }
 
+void LocationConfig::setAutoIndexFormat(AutoIndexFormat format)
+{
+	_autoindexFormat = format;
+}
+
 void LocationConfig::addAllowedMethod(const std::string& m)
 {
 	_validateMethod(m);
@@ -138,27 +201,221 @@ void LocationConfig::setIndexes(const std::vector<std::string>& indexes)
 	_indexes = indexes;
 }
 
+void LocationConfig::setFastCgiPass(const std::string& address)
+{
+	_validateFastCgiAddress(address);
+	_fastcgiPass = address;
+}
+
+void LocationConfig::setCgiPool(size_t workers, unsigned long maxRequests)
+{
+	if (workers < 1 || workers > 256) {
+		throw std::runtime_error("cgi_pool worker count must be between 1 and 256");
+	}
+	_cgiPoolSize = workers;
+	_cgiPoolMaxRequests = maxRequests;
+}
+
+void LocationConfig::setCgiMaxConcurrent(size_t limit)
+{
+	if (limit < 1) {
+		throw std::runtime_error("cgi_max_concurrent must be at least 1");
+	}
+	_cgiMaxConcurrent = limit;
+}
+
+void LocationConfig::setCgiQueue(size_t size, time_t timeout)
+{
+	if (timeout < 1) {
+		throw std::runtime_error("cgi_queue_size timeout must be at least 1 second");
+	}
+	_cgiQueueSize = size;
+	_cgiQueueTimeout = timeout;
+}
+
+void LocationConfig::setCgiTimeout(time_t timeout)
+{
+	if (timeout < 1) {
+		throw std::runtime_error("cgi_timeout must be at least 1 second");
+	}
+	_cgiTimeout = timeout;
+}
+
+void LocationConfig::setCgiRlimitCpu(unsigned long seconds)
+{
+	if (seconds < 1) {
+		throw std::runtime_error("cgi_rlimit_cpu must be at least 1 second");
+	}
+	_cgiRlimitCpu = seconds;
+}
+
+void LocationConfig::setCgiRlimitAs(size_t bytes)
+{
+	// Interpreters do not even start with less
+	if (bytes < 1048576) {
+		throw std::runtime_error("cgi_rlimit_as must be at least 1m");
+	}
+	_cgiRlimitAs = bytes;
+}
+
+void LocationConfig::setCgiCache(time_t ttl)
+{
+	if (ttl < 1) {
+		throw std::runtime_error("cgi_cache TTL must be at least 1 second");
+	}
+	_cgiCacheTtl = ttl;
+}
+
+// Only variables the cache knows how to expand are accepted, so a typo
+// fails at startup instead of silently merging unrelated responses
+void LocationConfig::setCgiCacheKey(const std::string& keyTemplate)
+{
+	for (size_t i = keyTemplate.find('$'); i != std::string::npos;
+		i = keyTemplate.find('$', i + 1)) {
+		size_t end = keyTemplate.find_first_not_of(
+			"abcdefghijklmnopqrstuvwxyz0123456789_", i + 1);
+		std::string name = keyTemplate.substr(i + 1,
+			end == std::string::npos ? std::string::npos : end - i - 1);
+		if (name != "method" && name != "host" && name != "path" && name != "query"
+			&& (name.compare(0, 5, "http_") != 0 || name.size() == 5)) {
+			throw std::runtime_error("Unknown cgi_cache_key variable: $" + name);
+		}
+	}
+	_cgiCacheKey = keyTemplate;
+}
+
+void LocationConfig::setCgiCacheMaxSize(size_t bytes)
+{
+	if (bytes == 0) {
+		throw std::runtime_error("cgi_cache_max_size cannot be zero");
+	}
+	_cgiCacheMaxSize = bytes;
+}
+
+void LocationConfig::setCgiSplice(bool enabled)
+{
+	_cgiSplice = enabled;
+}
+
+void LocationConfig::setMetrics(bool enabled)
+{
+	_metrics = enabled;
+}
+
+void LocationConfig::setInternal(bool internal)
+{
+	_internal = internal;
+}
+
+void LocationConfig::addRewrite(const std::string& pattern, const std::string& replacement,
+								RewriteProgram::Flag flag)
+{
+	_rewrites.add(pattern, replacement, flag);
+}
+
 const std::string& LocationConfig::getPath() const { return _path; }
+LocationConfig::Modifier LocationConfig::getModifier() const { return _modifier; }
+size_t LocationConfig::getOrder() const { return _order; }
+
+std::string LocationConfig::relativePath(const std::string& path) const
+{
+	if (_modifier == MATCH_REGEX || _modifier == MATCH_EXACT || _path == "/"
+		|| path.compare(0, _path.size(), _path) != 0) {
+		return path;
+	}
+	return path.substr(_path.size());
+}
 const std::string& LocationConfig::getRoot() const { return _root; }
 const std::vector<std::string>& LocationConfig::getIndexes() const { return _indexes; }
 bool LocationConfig::isAutoIndex() const { return _autoindex; }
+LocationConfig::AutoIndexFormat LocationConfig::getAutoIndexFormat() const { return _autoindexFormat; }
 const std::vector<std::string>& LocationConfig::getAllowedMethods() const { return _allowed_methods; }
 const std::map<int, std::string>& LocationConfig::getRedirects() const { return _redirects; }
 const std::map<std::string, std::string>& LocationConfig::getCgis() const { return _cgis; }
+const std::string& LocationConfig::getFastCgiPass() const { return _fastcgiPass; }
+size_t LocationConfig::getCgiPoolSize() const { return _cgiPoolSize; }
+unsigned long LocationConfig::getCgiPoolMaxRequests() const { return _cgiPoolMaxRequests; }
+size_t LocationConfig::getCgiMaxConcurrent() const { return _cgiMaxConcurrent; }
+size_t LocationConfig::getCgiQueueSize() const { return _cgiQueueSize; }
+time_t LocationConfig::getCgiQueueTimeout() const { return _cgiQueueTimeout; }
+time_t LocationConfig::getCgiTimeout() const { return _cgiTimeout; }
+unsigned long LocationConfig::getCgiRlimitCpu() const { return _cgiRlimitCpu; }
+size_t LocationConfig::getCgiRlimitAs() const { return _cgiRlimitAs; }
+time_t LocationConfig::getCgiCacheTtl() const { return _cgiCacheTtl; }
+const std::string& LocationConfig::getCgiCacheKey() const { return _cgiCacheKey; }
+size_t LocationConfig::getCgiCacheMaxSize() const { return _cgiCacheMaxSize; }
+bool LocationConfig::isCgiSplice() const { return _cgiSplice; }
+bool LocationConfig::isMetrics() const { return _metrics; }
+bool LocationConfig::isInternal() const { return _internal; }
+const RewriteProgram& LocationConfig::getRewrites() const { return _rewrites; }
 
-LocationConfig LocationConfig::inheritFromServer(const ServerConfig& server) const
+static void appendEnvVar(std::string &block, const std::string &name,
+						const std::string &value)
 {
-	LocationConfig result = *this;
+	block += name;
+	block += '=';
+	block += value;
+	block += '\0';
+}
 
-	// Inherit root if not set
-	if (result.getRoot().empty()) {
-		result.setRoot(server.getServerRoot());
+void LocationConfig::prepareCgiEnv(const ServerConfig& server)
+{
+	_cgiEnvTemplate.clear();
+	if (_cgis.empty() && _fastcgiPass.empty()) {
+		return;
 	}
 
-	// Inherit indexes if not set
-	if (result.getIndexes().empty()) {
-		result.setIndexes(server.getServerIndexes());
+	std::ostringstream port;
+	port << server.getServerPort();
+
+	appendEnvVar(_cgiEnvTemplate, "GATEWAY_INTERFACE", "CGI/1.1");
+	appendEnvVar(_cgiEnvTemplate, "SERVER_SOFTWARE", "webserv/1.0");
+	appendEnvVar(_cgiEnvTemplate, "SERVER_PROTOCOL", "HTTP/1.1");
+	appendEnvVar(_cgiEnvTemplate, "SERVER_NAME", server.getServerHost());
+	appendEnvVar(_cgiEnvTemplate, "SERVER_PORT", port.str());
+	appendEnvVar(_cgiEnvTemplate, "DOCUMENT_ROOT", _effectiveRoot);
+	appendEnvVar(_cgiEnvTemplate, "REDIRECT_STATUS", "200");
+}
+
+const std::string& LocationConfig::getCgiEnvTemplate() const { return _cgiEnvTemplate; }
+const Response& LocationConfig::getRedirectResponse() const { return _redirectResponse; }
+
+void LocationConfig::setRedirectResponse(const Response& response)
+{
+	_redirectResponse = response;
+}
+
+int LocationConfig::methodBit(const std::string& method)
+{
+	if (method == "GET")
+		return METHOD_GET;
+	if (method == "POST")
+		return METHOD_POST;
+	if (method == "DELETE")
+		return METHOD_DELETE;
+	return 0;
+}
+
+void LocationConfig::resolve(const ServerConfig& server)
+{
+	_methodMask = 0;
+	for (size_t i = 0; i < _allowed_methods.size(); ++i) {
+		_methodMask |= methodBit(_allowed_methods[i]);
 	}
 
-	return result;
+	_effectiveRoot = _root.empty() ? server.getServerRoot() : _root;
+
+	// Static handlers append the location root to the server root, minus
+	// any leading dots ("./uploads" -> "/uploads")
+	std::string::size_type start = _root.find_first_not_of(".");
+	_documentRoot = server.getServerRoot()
+		+ (start == std::string::npos ? std::string() : _root.substr(start));
 }
+
+bool LocationConfig::allowsMethod(const std::string& method) const
+{
+	return (_methodMask & methodBit(method)) != 0;
+}
+
+const std::string& LocationConfig::getEffectiveRoot() const { return _effectiveRoot; }
+const std::string& LocationConfig::getDocumentRoot() const { return _documentRoot; }
@@ -12,48 +12,161 @@
 
 #pragma once
 
-#include "ServerConfig.hpp"
 #include "../../inc/webserv.hpp"
+#include "RewriteProgram.hpp"
+#include "../http/Response.hpp"
 
 class ServerConfig;
 
 class LocationConfig
 {
 	public:
+		// How the location's path is matched, as in "location [=|^~|~] path"
+		enum Modifier
+		{
+			MATCH_PREFIX,
+			// "=": the request path must equal it
+			MATCH_EXACT,
+			// "^~": a longest prefix match that skips the regex locations
+			MATCH_PREFIX_ONLY,
+			// "~": a POSIX extended regex, tried in declaration order
+			MATCH_REGEX
+		};
+
+		// What "autoindex_format" renders directory listings as
+		enum AutoIndexFormat
+		{
+			AUTOINDEX_HTML,
+			AUTOINDEX_JSON
+		};
+
+		enum MethodBit
+		{
+			METHOD_GET = 1 << 0,
+			METHOD_POST = 1 << 1,
+			METHOD_DELETE = 1 << 2
+		};
+
 		LocationConfig();
 		~LocationConfig();
 
 		// Setters with validation
+		void setModifier(Modifier modifier);
+		// After setModifier: regex paths are checked as regexes
 		void setPath(const std::string& p);
+		void setOrder(size_t order);
 		void setRoot(const std::string& r);
 		void addIndex(const std::string& idx);
 		void setAutoIndex(bool a);
+		void setAutoIndexFormat(AutoIndexFormat format);
 		void addAllowedMethod(const std::string& m);
 		void addRedirect(int code, const std::string& target);
 		void addCgi(const std::string& ext, const std::string& cgi_path);
 		void setIndexes(const std::vector<std::string>& indexes);
+		void setFastCgiPass(const std::string& address);
+		void setCgiPool(size_t workers, unsigned long maxRequests);
+		void setCgiMaxConcurrent(size_t limit);
+		void setCgiQueue(size_t size, time_t timeout);
+		void setCgiTimeout(time_t timeout);
+		void setCgiRlimitCpu(unsigned long seconds);
+		void setCgiRlimitAs(size_t bytes);
+		void setCgiCache(time_t ttl);
+		void setCgiCacheKey(const std::string& keyTemplate);
+		void setCgiCacheMaxSize(size_t bytes);
+		void setCgiSplice(bool enabled);
+		void setMetrics(bool enabled);
+		void setInternal(bool internal);
+		void addRewrite(const std::string& pattern, const std::string& replacement,
+						RewriteProgram::Flag flag);
 
 		// Getters
 		const std::string& getPath() const;
+		Modifier getModifier() const;
+		// Position among the server's locations, in declaration order
+		size_t getOrder() const;
+		// What the request path maps to below this location's root: the
+		// part after a prefix location's path, or all of it for "/", for
+		// exact and regex locations and for paths it is not a prefix of
+		std::string relativePath(const std::string& path) const;
 		const std::string& getRoot() const;
 		const std::vector<std::string>& getIndexes() const;
 		bool isAutoIndex() const;
+		AutoIndexFormat getAutoIndexFormat() const;
 		const std::vector<std::string>& getAllowedMethods() const;
 		const std::map<int, std::string>& getRedirects() const;
 		const std::map<std::string, std::string>& getCgis() const;
-		LocationConfig inheritFromServer(const ServerConfig& server) const;
+		const std::string& getFastCgiPass() const;
+		size_t getCgiPoolSize() const;
+		unsigned long getCgiPoolMaxRequests() const;
+		size_t getCgiMaxConcurrent() const;
+		size_t getCgiQueueSize() const;
+		time_t getCgiQueueTimeout() const;
+		time_t getCgiTimeout() const;
+		unsigned long getCgiRlimitCpu() const;
+		size_t getCgiRlimitAs() const;
+		time_t getCgiCacheTtl() const;
+		const std::string& getCgiCacheKey() const;
+		size_t getCgiCacheMaxSize() const;
+		bool isCgiSplice() const;
+		bool isMetrics() const;
+		bool isInternal() const;
+		const RewriteProgram& getRewrites() const;
+
+		// Settings inherited from the server, flattened once when the config
+		// is loaded so requests only read them
+		void resolve(const ServerConfig& server);
+		bool allowsMethod(const std::string& method) const;
+		// The location's root, or the server's when it has none
+		const std::string& getEffectiveRoot() const;
+		// Server root joined with the location root, as static files use it
+		const std::string& getDocumentRoot() const;
+		static int methodBit(const std::string& method);
+
+		// CGI variables that do not depend on the request, as one
+		// "NAME=value\0..." block, computed once when the config is loaded
+		void prepareCgiEnv(const ServerConfig& server);
+		const std::string& getCgiEnvTemplate() const;
+
+		// The "return" response, frozen when the config is loaded
+		void setRedirectResponse(const Response& response);
+		const Response& getRedirectResponse() const;
 
 	private:
 		std::string _path;
+		Modifier _modifier;
+		size_t _order;
 		std::string _root;
 		std::vector<std::string> _indexes;
 		bool _autoindex;
+		AutoIndexFormat _autoindexFormat;
 		std::vector<std::string> _allowed_methods;
 		std::map<int, std::string> _redirects;
 		std::map<std::string, std::string> _cgis;
+		std::string _fastcgiPass;
+		size_t _cgiPoolSize;
+		unsigned long _cgiPoolMaxRequests;
+		size_t _cgiMaxConcurrent;
+		size_t _cgiQueueSize;
+		time_t _cgiQueueTimeout;
+		time_t _cgiTimeout;
+		unsigned long _cgiRlimitCpu;
+		size_t _cgiRlimitAs;
+		time_t _cgiCacheTtl;
+		std::string _cgiCacheKey;
+		size_t _cgiCacheMaxSize;
+		bool _cgiSplice;
+		bool _metrics;
+		bool _internal;
+		RewriteProgram _rewrites;
+		std::string _cgiEnvTemplate;
+		Response _redirectResponse;
+		int _methodMask;
+		std::string _effectiveRoot;
+		std::string _documentRoot;
 
 		void _validatePath(const std::string& path) const;
 		void _validateMethod(const std::string& method) const;
 		void _validateExtension(const std::string& ext) const;
 		void _validateStatusCode(int code) const;
+		void _validateFastCgiAddress(const std::string& address) const;
 };
@@ -0,0 +1,184 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LocationTrie.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:55:21 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:55:21 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "LocationTrie.hpp"
+#include "LocationConfig.hpp"
+
+static const size_t NO_NODE = static_cast<size_t>(-1);
+
+LocationMatch::LocationMatch() : prefix(NULL), location(NULL) {}
+
+LocationTrie::LocationTrie() : _root(NULL), _built(false) {}
+
+LocationTrie::LocationTrie(const LocationTrie&) : _root(NULL), _built(false) {}
+
+LocationTrie& LocationTrie::operator=(const LocationTrie &other)
+{
+	if (this != &other) {
+		_nodes.clear();
+		_exact.clear();
+		_regexes.clear();
+		_regexLocations.clear();
+		_root = NULL;
+		_built = false;
+	}
+	return *this;
+}
+
+static bool declaredBefore(const LocationConfig *a, const LocationConfig *b)
+{
+	return a->getOrder() < b->getOrder();
+}
+
+void LocationTrie::build(const std::map<std::string, LocationConfig> &locations)
+{
+	_nodes.clear();
+	_exact.clear();
+	_regexes.clear();
+	_regexLocations.clear();
+	_addNode("", NULL);
+
+	for (std::map<std::string, LocationConfig>::const_iterator it = locations.begin();
+		it != locations.end(); ++it) {
+		const LocationConfig &location = it->second;
+		if (location.getModifier() == LocationConfig::MATCH_EXACT)
+			_exact[location.getPath()] = &location;
+		else if (location.getModifier() == LocationConfig::MATCH_REGEX)
+			_regexLocations.push_back(&location);
+		else
+			_insert(location.getPath(), &location);
+	}
+
+	std::sort(_regexLocations.begin(), _regexLocations.end(), declaredBefore);
+	for (size_t i = 0; i < _regexLocations.size(); ++i)
+		_regexes.add(_regexLocations[i]->getPath());
+	_regexes.compile();
+
+	std::map<std::string, LocationConfig>::const_iterator slash = locations.find("/");
+	_root = (slash != locations.end()) ? &slash->second : NULL;
+	_built = true;
+}
+
+bool LocationTrie::isBuilt() const { return _built; }
+
+LocationMatch LocationTrie::match(const std::string &path) const
+{
+	LocationMatch result;
+
+	std::map<std::string, const LocationConfig *>::const_iterator exact = _exact.find(path);
+	if (exact != _exact.end()) {
+		result.prefix = exact->second;
+		result.location = exact->second;
+		return result;
+	}
+
+	result = _matchPrefix(path);
+	if (result.prefix && result.prefix->getModifier() == LocationConfig::MATCH_PREFIX_ONLY)
+		return result;
+
+	int regex = _regexes.match(path);
+	if (regex >= 0) {
+		result.prefix = _regexLocations[regex];
+		result.location = _regexLocations[regex];
+	}
+	return result;
+}
+
+LocationMatch LocationTrie::_matchPrefix(const std::string &path) const
+{
+	LocationMatch result;
+	size_t node = 0;
+	size_t depth = 0;
+
+	while (node != NO_NODE && !_nodes.empty()) {
+		const Node &current = _nodes[node];
+		if (current.location) {
+			// A location at this depth is a prefix of the path; it counts
+			// as a segment match when it ends one or the path does
+			const std::string &locPath = current.location->getPath();
+			result.prefix = current.location;
+			if (depth == path.size() || path[depth] == '/' || locPath == "/")
+				result.location = current.location;
+		}
+		if (depth >= path.size())
+			break;
+
+		size_t next = _child(node, path[depth]);
+		if (next == NO_NODE)
+			break;
+		const std::string &label = _nodes[next].label;
+		if (path.compare(depth, label.size(), label) != 0)
+			break;
+		depth += label.size();
+		node = next;
+	}
+
+	if (!result.location)
+		result.location = _root;
+	return result;
+}
+
+// Walks down as far as `path` shares labels, splitting the edge where they
+// diverge, and hangs the rest of the path off the last node reached
+void LocationTrie::_insert(const std::string &path, const LocationConfig *location)
+{
+	size_t node = 0;
+	size_t depth = 0;
+
+	while (depth < path.size()) {
+		size_t next = _child(node, path[depth]);
+		if (next == NO_NODE) {
+			size_t leaf = _addNode(path.substr(depth), location);
+			_nodes[node].children.push_back(leaf);
+			return;
+		}
+
+		std::string label = _nodes[next].label;
+		size_t common = 0;
+		while (common < label.size() && depth + common < path.size()
+			&& label[common] == path[depth + common])
+			common++;
+
+		if (common < label.size()) {
+			// The new path ends or forks inside this edge: the shared part
+			// becomes a node of its own, with the old edge below it
+			size_t split = _addNode(label.substr(0, common), NULL);
+			_nodes[next].label = label.substr(common);
+			_nodes[split].children.push_back(next);
+			std::replace(_nodes[node].children.begin(), _nodes[node].children.end(),
+				next, split);
+			next = split;
+		}
+		depth += common;
+		node = next;
+	}
+	_nodes[node].location = location;
+}
+
+size_t LocationTrie::_child(size_t node, char c) const
+{
+	const std::vector<size_t> &children = _nodes[node].children;
+	for (size_t i = 0; i < children.size(); ++i) {
+		if (_nodes[children[i]].label[0] == c)
+			return children[i];
+	}
+	return NO_NODE;
+}
+
+size_t LocationTrie::_addNode(const std::string &label, const LocationConfig *location)
+{
+	Node node;
+	node.label = label;
+	node.location = location;
+	_nodes.push_back(node);
+	return _nodes.size() - 1;
+}
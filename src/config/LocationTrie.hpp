@@ -0,0 +1,73 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LocationTrie.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:55:21 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:55:21 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "RegexSet.hpp"
+
+class LocationConfig;
+
+// What a request path resolves to. Looked up once per request and shared by
+// everything that handles it. An exact or regex location that wins is both.
+struct LocationMatch
+{
+	// Longest location path that is a prefix of the request path: CGI and
+	// internal locations are matched this way
+	const LocationConfig *prefix;
+	// Longest one that also ends at a path segment, else "/": the static
+	// file handlers are routed this way
+	const LocationConfig *location;
+
+	LocationMatch();
+};
+
+// A server's location paths compiled into a radix trie, so matching a path
+// costs one walk down it whatever the number of locations. Exact locations
+// are looked up first and regex ones go into one combined matcher, which is
+// tried unless the longest prefix is a "^~" one. Everything points into the
+// map it was built from; a copy starts out empty and has to be built again
+// against its owner's map.
+class LocationTrie
+{
+	public:
+		LocationTrie();
+		LocationTrie(const LocationTrie&);
+		LocationTrie& operator=(const LocationTrie&);
+
+		void build(const std::map<std::string, LocationConfig> &locations);
+		bool isBuilt() const;
+		LocationMatch match(const std::string &path) const;
+
+	private:
+		struct Node
+		{
+			// Edge from the parent; never empty below the root
+			std::string label;
+			const LocationConfig *location;
+			// Indices into _nodes, one per distinct first label byte
+			std::vector<size_t> children;
+		};
+
+		std::vector<Node> _nodes;
+		std::map<std::string, const LocationConfig *> _exact;
+		RegexSet _regexes;
+		// The location of each pattern in _regexes, in the same order
+		std::vector<const LocationConfig *> _regexLocations;
+		const LocationConfig *_root;
+		bool _built;
+
+		LocationMatch _matchPrefix(const std::string &path) const;
+		void _insert(const std::string &path, const LocationConfig *location);
+		size_t _child(size_t node, char c) const;
+		size_t _addNode(const std::string &label, const LocationConfig *location);
+};
@@ -0,0 +1,106 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MimeTypes.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 19:58:36 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 19:58:36 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "MimeTypes.hpp"
+#include <list>
+
+static const char *const BUILTIN_TYPES[][2] = {
+	{"html", "text/html"},
+	{"htm", "text/html"},
+	{"css", "text/css"},
+	{"txt", "text/plain"},
+	{"csv", "text/csv"},
+	{"xml", "text/xml"},
+	{"js", "application/javascript"},
+	{"mjs", "application/javascript"},
+	{"json", "application/json"},
+	{"pdf", "application/pdf"},
+	{"wasm", "application/wasm"},
+	{"zip", "application/zip"},
+	{"gif", "image/gif"},
+	{"jpg", "image/jpeg"},
+	{"jpeg", "image/jpeg"},
+	{"png", "image/png"},
+	{"webp", "image/webp"},
+	{"svg", "image/svg+xml"},
+	{"ico", "image/x-icon"},
+	{"woff", "font/woff"},
+	{"woff2", "font/woff2"},
+	{"ttf", "font/ttf"},
+	{"mp3", "audio/mpeg"},
+	{"mp4", "video/mp4"},
+	{"webm", "video/webm"},
+	{NULL, NULL}
+};
+
+MimeTypes::MimeTypes() : _builtin(true)
+{
+	static const Table* builtin = NULL;
+	if (!builtin)
+	{
+		Table types;
+		for (size_t i = 0; BUILTIN_TYPES[i][0]; ++i)
+			types[BUILTIN_TYPES[i][0]] = BUILTIN_TYPES[i][1];
+		builtin = _intern(types);
+	}
+	_types = builtin;
+}
+
+MimeTypes::MimeTypes(const Table& types) :
+	_types(_intern(types)),
+	_builtin(false)
+{}
+
+// A process sees a handful of distinct tables, kept until it exits
+const MimeTypes::Table* MimeTypes::_intern(const Table& types)
+{
+	static std::list<Table> tables;
+	for (std::list<Table>::const_iterator it = tables.begin(); it != tables.end(); ++it)
+	{
+		if (*it == types)
+			return &*it;
+	}
+	tables.push_back(types);
+	return &tables.back();
+}
+
+void MimeTypes::add(Table& types, const std::string& type, const std::string& extension)
+{
+	if (type.find('/') == std::string::npos)
+		throw std::runtime_error("Invalid MIME type: " + type);
+
+	std::string key = extension;
+	for (size_t i = 0; i < key.size(); ++i)
+		key[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(key[i])));
+	types[key] = type;
+}
+
+bool MimeTypes::isBuiltin() const
+{
+	return _builtin;
+}
+
+const std::string& MimeTypes::lookup(const std::string& path) const
+{
+	static const std::string defaultType = "application/octet-stream";
+
+	size_t dot = path.find_last_of("./");
+	if (dot == std::string::npos || path[dot] != '.' || dot + 1 == path.size())
+		return defaultType;
+
+	std::string key(path, dot + 1);
+	for (size_t i = 0; i < key.size(); ++i)
+		key[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(key[i])));
+
+	Table::const_iterator it = _types->find(key);
+	return (it != _types->end()) ? it->second : defaultType;
+}
@@ -0,0 +1,48 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MimeTypes.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 19:58:36 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 19:58:36 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+
+// Content types by file extension, as given by a "types { ... }" block or an
+// included mime.types file. Until one is configured a built-in table covering
+// the usual web formats is used; a types block replaces it entirely.
+//
+// Tables are interned: every MimeTypes built from an equal table points to
+// the same one, so thousands of servers sharing a mime.types hold one copy
+// and copying a MimeTypes copies a pointer.
+class MimeTypes
+{
+	public:
+		// Keyed by lowercased extension
+		typedef std::map<std::string, std::string> Table;
+
+		MimeTypes();
+		explicit MimeTypes(const Table& types);
+
+		// Maps `extension` (without the dot, any case) to `type` in a table
+		// being built
+		static void add(Table& types, const std::string& type,
+						const std::string& extension);
+		bool isBuiltin() const;
+
+		// Type of the file `path` names, by its extension;
+		// application/octet-stream when it has none or an unknown one
+		const std::string& lookup(const std::string& path) const;
+
+	private:
+		const Table* _types;
+		bool _builtin;
+
+		static const Table* _intern(const Table& types);
+};
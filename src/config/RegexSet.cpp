@@ -0,0 +1,136 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RegexSet.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:47:21 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:47:21 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "RegexSet.hpp"
+
+static std::string regexError(int code, const regex_t *re, const std::string &pattern)
+{
+	char buf[256];
+	regerror(code, re, buf, sizeof(buf));
+	return "Invalid regex '" + pattern + "': " + buf;
+}
+
+RegexSet::RegexSet() : _compiled(false) {}
+
+RegexSet::RegexSet(const RegexSet&) : _compiled(false) {}
+
+RegexSet& RegexSet::operator=(const RegexSet &other)
+{
+	if (this != &other)
+		clear();
+	return *this;
+}
+
+RegexSet::~RegexSet()
+{
+	clear();
+}
+
+void RegexSet::validate(const std::string &pattern)
+{
+	// Group numbers shift once patterns are combined, so \1 would point
+	// into another pattern
+	for (size_t i = 0; i + 1 < pattern.size(); ++i) {
+		if (pattern[i] != '\\')
+			continue;
+		if (pattern[i + 1] >= '1' && pattern[i + 1] <= '9')
+			throw std::runtime_error("Back-references are not supported in '" + pattern + "'");
+		++i;
+	}
+
+	regex_t re;
+	int code = regcomp(&re, pattern.c_str(), REG_EXTENDED);
+	if (code != 0)
+		throw std::runtime_error(regexError(code, &re, pattern));
+	regfree(&re);
+}
+
+void RegexSet::add(const std::string &pattern)
+{
+	validate(pattern);
+	_patterns.push_back(pattern);
+}
+
+void RegexSet::compile()
+{
+	std::vector<std::string> patterns;
+	patterns.swap(_patterns);
+	clear();
+	_patterns.swap(patterns);
+	if (_patterns.empty())
+		return;
+
+	std::string combined;
+	size_t group = 1;
+	for (size_t i = 0; i < _patterns.size(); ++i) {
+		regex_t re;
+		int code = regcomp(&re, _patterns[i].c_str(), REG_EXTENDED);
+		if (code != 0) {
+			std::string message = regexError(code, &re, _patterns[i]);
+			clear();
+			throw std::runtime_error(message);
+		}
+		_single.push_back(re);
+		_groups.push_back(group);
+		group += 1 + re.re_nsub;
+
+		if (i > 0)
+			combined += '|';
+		combined += '(' + _patterns[i] + ')';
+	}
+
+	int code = regcomp(&_combined, combined.c_str(), REG_EXTENDED);
+	if (code != 0) {
+		std::string message = regexError(code, &_combined, combined);
+		clear();
+		throw std::runtime_error(message);
+	}
+	_compiled = true;
+}
+
+void RegexSet::clear()
+{
+	for (size_t i = 0; i < _single.size(); ++i)
+		regfree(&_single[i]);
+	_single.clear();
+	_groups.clear();
+	_patterns.clear();
+	if (_compiled)
+		regfree(&_combined);
+	_compiled = false;
+}
+
+bool RegexSet::empty() const
+{
+	return _patterns.empty();
+}
+
+int RegexSet::match(const std::string &subject) const
+{
+	if (!_compiled)
+		return -1;
+
+	std::vector<regmatch_t> groups(_combined.re_nsub + 1);
+	if (regexec(&_combined, subject.c_str(), groups.size(), &groups[0], 0) != 0)
+		return -1;
+
+	size_t hit = 0;
+	while (hit < _groups.size() && groups[_groups[hit]].rm_so == -1)
+		++hit;
+
+	// The combined match is leftmost-longest, not first-declared
+	for (size_t i = 0; i < hit; ++i) {
+		if (regexec(&_single[i], subject.c_str(), 0, NULL, 0) == 0)
+			return static_cast<int>(i);
+	}
+	return (hit < _groups.size()) ? static_cast<int>(hit) : -1;
+}
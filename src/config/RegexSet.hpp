@@ -0,0 +1,53 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RegexSet.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:47:21 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:47:21 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include <regex.h>
+
+// POSIX extended regexes compiled together as one "(a)|(b)|..." alternation.
+// A subject none of them matches, the common case, costs a single regexec;
+// on a hit the group that took part names a matching pattern, and only the
+// patterns before it are tried on their own to honour declaration order.
+// A copy starts out empty, like the trie that owns it.
+class RegexSet
+{
+	public:
+		RegexSet();
+		RegexSet(const RegexSet&);
+		RegexSet& operator=(const RegexSet&);
+		~RegexSet();
+
+		// Throws when the pattern does not compile
+		void add(const std::string &pattern);
+		// Builds the combined matcher from everything added so far
+		void compile();
+		void clear();
+		bool empty() const;
+
+		// Index of the first pattern, in the order added, that matches
+		// `subject`, or -1
+		int match(const std::string &subject) const;
+
+		// Throws with regerror's message when `pattern` is not a valid
+		// extended regex or uses back-references
+		static void validate(const std::string &pattern);
+
+	private:
+		std::vector<std::string> _patterns;
+		std::vector<regex_t> _single;
+		// Subexpression number of each pattern's group in _combined
+		std::vector<size_t> _groups;
+		regex_t _combined;
+		bool _compiled;
+};
@@ -0,0 +1,174 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RewriteProgram.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 19:20:03 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 19:20:03 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "RewriteProgram.hpp"
+#include "../utils/Metrics.hpp"
+
+// Room for the captures on top of a replacement's literal text; the buffer
+// only grows past this for unusually long paths
+static const size_t CAPTURE_RESERVE = 1024;
+
+static bool startsWith(const std::string &str, const char *prefix)
+{
+	return str.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+RewriteProgram::RewriteProgram() {}
+
+RewriteProgram::RewriteProgram(const RewriteProgram &other)
+{
+	for (size_t i = 0; i < other._rules.size(); ++i)
+		add(other._rules[i].pattern, other._rules[i].replacement, other._rules[i].flag);
+}
+
+RewriteProgram &RewriteProgram::operator=(const RewriteProgram &other)
+{
+	if (this != &other) {
+		_clear();
+		for (size_t i = 0; i < other._rules.size(); ++i)
+			add(other._rules[i].pattern, other._rules[i].replacement, other._rules[i].flag);
+	}
+	return *this;
+}
+
+RewriteProgram::~RewriteProgram()
+{
+	_clear();
+}
+
+bool RewriteProgram::parseFlag(const std::string &name, Flag &flag)
+{
+	if (name == "last")
+		flag = FLAG_LAST;
+	else if (name == "break")
+		flag = FLAG_BREAK;
+	else if (name == "redirect")
+		flag = FLAG_REDIRECT;
+	else if (name == "permanent")
+		flag = FLAG_PERMANENT;
+	else
+		return false;
+	return true;
+}
+
+void RewriteProgram::add(const std::string &pattern, const std::string &replacement, Flag flag)
+{
+	Rule rule;
+	rule.pattern = pattern;
+	rule.replacement = replacement;
+	rule.flag = flag;
+
+	int code = regcomp(&rule.regex, pattern.c_str(), REG_EXTENDED);
+	if (code != 0) {
+		char buf[256];
+		regerror(code, &rule.regex, buf, sizeof(buf));
+		throw std::runtime_error("Invalid rewrite regex '" + pattern + "': " + buf);
+	}
+
+	size_t literal = 0;
+	for (size_t i = 0; i < replacement.size(); ++i) {
+		if (replacement[i] == '$' && i + 1 < replacement.size()
+			&& replacement[i + 1] >= '1' && replacement[i + 1] <= '9') {
+			Piece capture;
+			capture.group = replacement[++i] - '0';
+			if (capture.group > rule.regex.re_nsub) {
+				regfree(&rule.regex);
+				throw std::runtime_error("Rewrite replacement '" + replacement
+					+ "' refers to a group '" + pattern + "' does not have");
+			}
+			rule.pieces.push_back(capture);
+			continue;
+		}
+		if (rule.pieces.empty() || rule.pieces.back().group != 0) {
+			Piece text;
+			text.group = 0;
+			rule.pieces.push_back(text);
+		}
+		rule.pieces.back().text += replacement[i];
+		literal++;
+	}
+
+	rule.setsArgs = replacement.find('?') != std::string::npos;
+	rule.dropsArgs = !replacement.empty() && replacement[replacement.size() - 1] == '?';
+	rule.absolute = startsWith(replacement, "http://") || startsWith(replacement, "https://");
+	rule.metric = Metrics::label("rewrite_matches_total", "rule", pattern);
+
+	_rules.push_back(rule);
+	_matches.resize(std::max(_matches.size(), rule.regex.re_nsub + 1));
+	_buffer.reserve(std::max(_buffer.capacity(), literal + CAPTURE_RESERVE));
+}
+
+bool RewriteProgram::empty() const
+{
+	return _rules.empty();
+}
+
+RewriteProgram::Action RewriteProgram::run(std::string &path, std::string &args, int &status) const
+{
+	Action action = REWRITE_NONE;
+
+	for (size_t i = 0; i < _rules.size(); ++i) {
+		const Rule &rule = _rules[i];
+		if (regexec(&rule.regex, path.c_str(), _matches.size(), &_matches[0], 0) != 0)
+			continue;
+
+		Metrics::increment(rule.metric);
+		_substitute(rule, path);
+
+		if (rule.setsArgs) {
+			size_t query = _buffer.find('?');
+			size_t end = rule.dropsArgs ? _buffer.size() - 1 : _buffer.size();
+			std::string newArgs = (query < end) ? _buffer.substr(query + 1, end - query - 1) : "";
+			if (!rule.dropsArgs && !args.empty())
+				newArgs += newArgs.empty() ? args : "&" + args;
+			args = newArgs;
+			path.assign(_buffer, 0, query);
+		} else {
+			path.assign(_buffer);
+		}
+
+		if (rule.flag == FLAG_REDIRECT || rule.flag == FLAG_PERMANENT || rule.absolute) {
+			status = (rule.flag == FLAG_PERMANENT) ? 301 : 302;
+			if (!args.empty())
+				path += "?" + args;
+			return REWRITE_REDIRECT;
+		}
+		if (rule.flag == FLAG_BREAK)
+			return REWRITE_BREAK;
+		action = REWRITE_LAST;
+		if (rule.flag == FLAG_LAST)
+			break;
+	}
+	return action;
+}
+
+void RewriteProgram::_substitute(const Rule &rule, const std::string &path) const
+{
+	_buffer.clear();
+	for (size_t i = 0; i < rule.pieces.size(); ++i) {
+		const Piece &piece = rule.pieces[i];
+		if (piece.group == 0) {
+			_buffer += piece.text;
+			continue;
+		}
+		const regmatch_t &match = _matches[piece.group];
+		if (match.rm_so >= 0)
+			_buffer.append(path, match.rm_so, match.rm_eo - match.rm_so);
+	}
+}
+
+void RewriteProgram::_clear()
+{
+	for (size_t i = 0; i < _rules.size(); ++i)
+		regfree(&_rules[i].regex);
+	_rules.clear();
+}
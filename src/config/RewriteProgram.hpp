@@ -0,0 +1,92 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RewriteProgram.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 19:20:03 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 19:20:03 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include <regex.h>
+
+// The "rewrite regex replacement [flag]" directives of one server or
+// location block, compiled when the config is loaded: each regex once, each
+// replacement into literal and $1..$9 pieces. Running them copies captures
+// into a buffer kept between requests instead of building strings.
+class RewriteProgram
+{
+	public:
+		enum Flag
+		{
+			// Rewrites and goes on with the next rule
+			FLAG_NONE,
+			// Stops here and looks the location up again
+			FLAG_LAST,
+			// Stops here and stays in the current location
+			FLAG_BREAK,
+			FLAG_REDIRECT,
+			FLAG_PERMANENT
+		};
+
+		enum Action
+		{
+			// No rule matched
+			REWRITE_NONE,
+			// The path changed: look the location up again
+			REWRITE_LAST,
+			REWRITE_BREAK,
+			// `path` is a redirect target, sent with `status`
+			REWRITE_REDIRECT
+		};
+
+		RewriteProgram();
+		RewriteProgram(const RewriteProgram &other);
+		RewriteProgram &operator=(const RewriteProgram &other);
+		~RewriteProgram();
+
+		// Throws when the regex does not compile or the replacement refers
+		// to a group it does not have
+		void add(const std::string &pattern, const std::string &replacement, Flag flag);
+		bool empty() const;
+
+		// Runs the rules in order over `path`, updating it and `args`
+		Action run(std::string &path, std::string &args, int &status) const;
+
+		static bool parseFlag(const std::string &name, Flag &flag);
+
+	private:
+		struct Piece
+		{
+			// A capture group number, or 0 for literal text
+			size_t group;
+			std::string text;
+		};
+
+		struct Rule
+		{
+			std::string pattern;
+			std::string replacement;
+			Flag flag;
+			regex_t regex;
+			std::vector<Piece> pieces;
+			// The replacement carries its own query string; a trailing '?'
+			// drops the original one instead of appending it
+			bool setsArgs;
+			bool dropsArgs;
+			bool absolute;
+			std::string metric;
+		};
+
+		std::vector<Rule> _rules;
+		mutable std::vector<regmatch_t> _matches;
+		mutable std::string _buffer;
+
+		void _clear();
+		void _substitute(const Rule &rule, const std::string &path) const;
+};
@@ -11,9 +11,12 @@
 /* ************************************************************************** */
 
 #include "ServerConfig.hpp"
+#include "../http/HttpStatus.hpp"
 
 ServerConfig::ServerConfig() : _root("./pages"),
-							   _clientMaxBodySize(1048576)
+							   _clientMaxBodySize(1048576),
+							   _clientBodyBufferSize(16384),
+							   _serverAutoIndex(false)
 {
 	_indexes.push_back("./pages/index.html");
 }
@@ -23,10 +26,24 @@ ServerConfig::~ServerConfig() {}
 const std::string &ServerConfig::getServerRoot() const { return _root; }
 const std::vector<std::string> &ServerConfig::getServerIndexes() const { return _indexes; }
 size_t ServerConfig::getClientMaxBodySize() const { return _clientMaxBodySize; }
+size_t ServerConfig::getClientBodyBufferSize() const { return _clientBodyBufferSize; }
 const std::map<std::string, ListenConfig> &ServerConfig::getListens() const { return _listens; }
 const std::map<std::string, LocationConfig> &ServerConfig::getLocations() const { return _locations; }
 const std::map<int, std::string> &ServerConfig::getErrorPage() const { return _errorPage; }
 bool ServerConfig::getServerAutoIndex() const { return _serverAutoIndex; }
+const RewriteProgram &ServerConfig::getRewrites() const { return _rewrites; }
+const MimeTypes &ServerConfig::getMimeTypes() const { return _mimeTypes; }
+
+const Response *ServerConfig::getErrorResponse(int code) const
+{
+	std::map<int, Response>::const_iterator it = _errorResponses.find(code);
+	return it != _errorResponses.end() ? &it->second : NULL;
+}
+
+void ServerConfig::setMimeTypes(const MimeTypes &types)
+{
+	_mimeTypes = types;
+}
 
 std::string ServerConfig::getServerHost() const
 {
@@ -76,8 +93,11 @@ void ServerConfig::_validateServerName(const std::string &name) const
 		throw std::runtime_error("Server name cannot be empty");
 	}
 
+	// A leading "*." makes it a wildcard for every subdomain
+	size_t start = (name.compare(0, 2, "*.") == 0 && name.size() > 2) ? 2 : 0;
+
 	// Check for invalid characters
-	for (size_t i = 0; i < name.size(); i++)
+	for (size_t i = start; i < name.size(); i++)
 	{
 		unsigned char c = name[i];
 		if (!std::isalnum(c) && c != '-' && c != '.' && c != '_')
@@ -159,21 +179,85 @@ void ServerConfig::setClientMaxBodySize(size_t size)
 	_clientMaxBodySize = size;
 }
 
-void ServerConfig::addLocation(const LocationConfig &loc)
+void ServerConfig::setClientBodyBufferSize(size_t size)
+{
+	_clientBodyBufferSize = size;
+}
+
+// Prefix locations are keyed by their path, "^~" ones included; exact and
+// regex ones carry their modifier so they never collide with them
+LocationConfig &ServerConfig::addLocation(LocationConfig::Modifier modifier,
+										const std::string &path)
+{
+	std::string key = path;
+	if (modifier == LocationConfig::MATCH_EXACT)
+		key = "= " + key;
+	else if (modifier == LocationConfig::MATCH_REGEX)
+		key = "~ " + key;
+
+	if (_locations.find(key) != _locations.end())
+	{
+		throw std::runtime_error("Duplicate location path: " + key);
+	}
+	LocationConfig &loc = _locations[key];
+	loc.setModifier(modifier);
+	loc.setPath(path);
+	loc.setOrder(_locations.size() - 1);
+	return loc;
+}
+
+void ServerConfig::prepareLocations()
 {
-	const std::string &path = loc.getPath();
-	if (_locations.find(path) != _locations.end())
+	for (std::map<std::string, LocationConfig>::iterator it = _locations.begin();
+		it != _locations.end(); ++it)
 	{
-		throw std::runtime_error("Duplicate location path: " + path);
+		it->second.resolve(*this);
+		it->second.prepareCgiEnv(*this);
 	}
-	_locations[path] = loc;
 }
 
-void ServerConfig::addListen(const std::string &token)
+void ServerConfig::addRewrite(const std::string &pattern, const std::string &replacement,
+							RewriteProgram::Flag flag)
+{
+	_rewrites.add(pattern, replacement, flag);
+}
+
+void ServerConfig::compileRoutes()
+{
+	_routes.build(_locations);
+}
+
+void ServerConfig::prepareResponses()
+{
+	HttpStatus::prerender(*this, _errorResponses);
+
+	for (std::map<std::string, LocationConfig>::iterator it = _locations.begin();
+		it != _locations.end(); ++it)
+	{
+		const std::map<int, std::string> &redirects = it->second.getRedirects();
+		if (redirects.empty())
+			continue;
+		Response response;
+		handleRedirect(response, redirects.begin()->first, redirects.begin()->second);
+		response.freeze();
+		it->second.setRedirectResponse(response);
+	}
+}
+
+LocationMatch ServerConfig::matchLocation(const std::string &path) const
+{
+	// A copy that was never compiled builds its trie on first use
+	if (!_routes.isBuilt())
+		_routes.build(_locations);
+	return _routes.match(path);
+}
+
+void ServerConfig::addListen(const std::string &token, bool defaultServer)
 {
 	try
 	{
 		ListenConfig listen(token);
+		listen.setDefaultServer(defaultServer);
 		_listens[listen.getIpPortJoin()] = listen;
 	}
 	catch (const std::exception &e)
@@ -14,6 +14,10 @@
 
 #include "LocationConfig.hpp"
 #include "ListenConfig.hpp"
+#include "LocationTrie.hpp"
+#include "RewriteProgram.hpp"
+#include "MimeTypes.hpp"
+#include "../http/Response.hpp"
 #include "../../inc/webserv.hpp"
 
 class LocationConfig; // Forward declaration to avoid circular dependency
@@ -32,12 +36,17 @@ class ServerConfig
 		std::string getServerHost() const;
 		unsigned int getServerPort() const;
 		size_t getClientMaxBodySize() const;
+		size_t getClientBodyBufferSize() const;
 		const std::map<std::string, LocationConfig>& getLocations() const;
 		const std::map<int, std::string> &getErrorPage() const;
 		bool getServerAutoIndex() const;
+		const RewriteProgram& getRewrites() const;
+		const MimeTypes& getMimeTypes() const;
+		// Pre-rendered error response, NULL for codes without one
+		const Response* getErrorResponse(int code) const;
 
 		// Setters with validation
-		void addListen(const std::string& token);
+		void addListen(const std::string& token, bool defaultServer);
 		void addServerName(const std::string& name);
 		void setRoot(const std::string& root);
 		void setHost(const std::string& host);
@@ -45,8 +54,23 @@ class ServerConfig
 		void setIndex(const std::vector<std::string>& index);
 		void setErrorPage(int code, const std::string& path);
 		void setServerAutoIndex(bool flag);
+		void setMimeTypes(const MimeTypes& types);
 		void setClientMaxBodySize(size_t size);
-		void addLocation(const LocationConfig& loc);
+		void setClientBodyBufferSize(size_t size);
+		// The new location is filled in place, where it will stay
+		LocationConfig& addLocation(LocationConfig::Modifier modifier,
+									const std::string& path);
+		void addRewrite(const std::string& pattern, const std::string& replacement,
+						RewriteProgram::Flag flag);
+		// Precomputes per-location state once the whole block is known
+		void prepareLocations();
+		// Compiles the locations into the trie matchLocation() walks. Needed
+		// again after copying, since the trie points into this object.
+		void compileRoutes();
+		// Renders error pages and location redirects into frozen responses.
+		// Runs last, once types and error pages are final.
+		void prepareResponses();
+		LocationMatch matchLocation(const std::string &path) const;
 		std::string getErrorPage(int code) const;
 
 	private:
@@ -55,8 +79,13 @@ class ServerConfig
 		std::string _root;
 		std::vector<std::string> _indexes;
 		size_t _clientMaxBodySize;
+		size_t _clientBodyBufferSize;
 		std::map<std::string, LocationConfig> _locations;
+		mutable LocationTrie _routes;
+		RewriteProgram _rewrites;
+		MimeTypes _mimeTypes;
 		std::map<int, std::string> _errorPage;
+		std::map<int, Response> _errorResponses;
 		bool _serverAutoIndex;
 
 		std::string _intToString(int v) const;
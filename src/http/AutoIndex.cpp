@@ -0,0 +1,274 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AutoIndex.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:02:41 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:02:41 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "AutoIndex.hpp"
+#include "HttpStatus.hpp"
+#include "../utils/Metrics.hpp"
+
+// Bound on the memory all cached listings take together
+static const size_t MAX_CACHE_BYTES = 32 * 1024 * 1024;
+// Larger listings are rendered on every request rather than evict the rest
+static const size_t MAX_LISTING_BYTES = MAX_CACHE_BYTES / 4;
+
+std::list<AutoIndex::Entry> AutoIndex::_lru;
+std::map<AutoIndex::Key, std::list<AutoIndex::Entry>::iterator> AutoIndex::_index;
+size_t AutoIndex::_bytes = 0;
+
+bool AutoIndex::Key::operator<(const Key &other) const
+{
+	if (inode != other.inode)
+		return inode < other.inode;
+	if (device != other.device)
+		return device < other.device;
+	if (format != other.format)
+		return format < other.format;
+	return urlPath < other.urlPath;
+}
+
+bool AutoIndex::Item::operator<(const Item &other) const
+{
+	if (isDirectory != other.isDirectory)
+		return isDirectory;
+	return name < other.name;
+}
+
+static void appendHtmlEscaped(std::string &out, const std::string &text)
+{
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		switch (text[i])
+		{
+			case '&': out += "&amp;"; break;
+			case '<': out += "&lt;"; break;
+			case '>': out += "&gt;"; break;
+			case '"': out += "&quot;"; break;
+			default: out += text[i];
+		}
+	}
+}
+
+// Percent-encodes everything but unreserved characters and '/'
+static void appendUriEncoded(std::string &out, const std::string &path)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	for (size_t i = 0; i < path.size(); ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(path[i]);
+		if (std::isalnum(c) || c == '/' || c == '-' || c == '.' || c == '_' || c == '~')
+			out += static_cast<char>(c);
+		else
+		{
+			out += '%';
+			out += hex[c >> 4];
+			out += hex[c & 0x0F];
+		}
+	}
+}
+
+static void appendJsonString(std::string &out, const std::string &text)
+{
+	static const char hex[] = "0123456789abcdef";
+	out += '"';
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += static_cast<char>(c);
+		}
+		else if (c < 0x20)
+		{
+			out += "\\u00";
+			out += hex[c >> 4];
+			out += hex[c & 0x0F];
+		}
+		else
+			out += static_cast<char>(c);
+	}
+	out += '"';
+}
+
+Response AutoIndex::render(const ServerConfig &config, const LocationConfig &location,
+						const std::string &dirPath, const std::string &urlPath,
+						Response &response)
+{
+	struct stat st;
+	if (stat(dirPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+		return HttpStatus::buildResponse(config, response, 404);
+
+	LocationConfig::AutoIndexFormat format = location.getAutoIndexFormat();
+	const char *contentType = (format == LocationConfig::AUTOINDEX_JSON)
+		? "application/json" : "text/html";
+
+	Key key;
+	key.device = st.st_dev;
+	key.inode = st.st_ino;
+	key.format = format;
+	key.urlPath = urlPath;
+	if (key.urlPath.empty() || key.urlPath[key.urlPath.size() - 1] != '/')
+		key.urlPath += '/';
+
+	// Adding, removing or renaming an entry updates the directory's mtime
+	std::map<Key, std::list<Entry>::iterator>::iterator it = _index.find(key);
+	if (it != _index.end())
+	{
+		if (it->second->mtime == st.st_mtime)
+		{
+			_lru.splice(_lru.begin(), _lru, it->second);
+			Metrics::increment("autoindex_cache_hits_total");
+			response.setStatus(200, "OK");
+			response.setHeader("Content-Type", contentType);
+			response.setBody(it->second->body);
+			return response;
+		}
+		_erase(it->second);
+	}
+	Metrics::increment("autoindex_cache_misses_total");
+
+	std::vector<Item> items;
+	if (!_read(dirPath, items))
+		return HttpStatus::buildResponse(config, response, 403);
+	std::sort(items.begin(), items.end());
+
+	std::string body;
+	if (format == LocationConfig::AUTOINDEX_JSON)
+		_renderJson(items, body);
+	else
+		_renderHtml(items, key.urlPath, body);
+
+	// Changes later in the same second would not move the mtime
+	if (st.st_mtime < time(NULL))
+		_store(key, st.st_mtime, body);
+
+	response.setStatus(200, "OK");
+	response.setHeader("Content-Type", contentType);
+	response.setBody(body);
+	return response;
+}
+
+void AutoIndex::cleanup()
+{
+	_lru.clear();
+	_index.clear();
+	_bytes = 0;
+}
+
+// Entry types come from readdir() itself; only file systems that do not
+// report them, and symlinks, cost an fstatat() each
+bool AutoIndex::_read(const std::string &dirPath, std::vector<Item> &items)
+{
+	DIR *dir = opendir(dirPath.c_str());
+	if (!dir)
+		return false;
+	int fd = dirfd(dir);
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (std::strcmp(entry->d_name, ".") == 0)
+			continue;
+
+		Item item;
+		item.name = entry->d_name;
+		item.isDirectory = (entry->d_type == DT_DIR);
+		if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+		{
+			struct stat st;
+			item.isDirectory = fstatat(fd, entry->d_name, &st, 0) == 0
+				&& S_ISDIR(st.st_mode);
+		}
+		items.push_back(item);
+	}
+	closedir(dir);
+	return true;
+}
+
+void AutoIndex::_renderHtml(const std::vector<Item> &items, const std::string &base,
+							std::string &body)
+{
+	body.reserve(128 + items.size() * (2 * base.size() + 48));
+	body += "<html><head><title>Index of ";
+	appendHtmlEscaped(body, base);
+	body += "</title></head><body><h1>Index of ";
+	appendHtmlEscaped(body, base);
+	body += "</h1><ul>";
+
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		const Item &item = items[i];
+		body += "<li><a href=\"";
+		appendUriEncoded(body, base);
+		appendUriEncoded(body, item.name);
+		if (item.isDirectory)
+			body += '/';
+		body += "\">";
+		appendHtmlEscaped(body, item.name);
+		if (item.isDirectory)
+			body += '/';
+		body += "</a></li>";
+	}
+	body += "</ul></body></html>";
+}
+
+// [{"name":"a","type":"directory"},{"name":"b.txt","type":"file"}]
+void AutoIndex::_renderJson(const std::vector<Item> &items, std::string &body)
+{
+	body.reserve(2 + items.size() * 48);
+	body += '[';
+	bool first = true;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		const Item &item = items[i];
+		if (item.name == "..")
+			continue;
+		if (!first)
+			body += ',';
+		first = false;
+		body += "{\"name\":";
+		appendJsonString(body, item.name);
+		body += item.isDirectory ? ",\"type\":\"directory\"}" : ",\"type\":\"file\"}";
+	}
+	body += ']';
+}
+
+void AutoIndex::_store(const Key &key, time_t mtime, const std::string &body)
+{
+	if (body.size() > MAX_LISTING_BYTES)
+		return;
+
+	while (!_lru.empty() && _bytes + body.size() > MAX_CACHE_BYTES)
+		_erase(--_lru.end());
+
+	Entry entry;
+	entry.key = key;
+	entry.mtime = mtime;
+	entry.body = body;
+	_lru.push_front(entry);
+	_index[key] = _lru.begin();
+	_bytes += body.size();
+	_updateGauges();
+}
+
+void AutoIndex::_erase(std::list<Entry>::iterator entry)
+{
+	_bytes -= entry->body.size();
+	_index.erase(entry->key);
+	_lru.erase(entry);
+	_updateGauges();
+}
+
+void AutoIndex::_updateGauges()
+{
+	Metrics::setGauge("autoindex_cache_bytes", _bytes);
+	Metrics::setGauge("autoindex_cache_entries", _index.size());
+}
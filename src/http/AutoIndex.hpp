@@ -0,0 +1,79 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AutoIndex.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:02:41 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:02:41 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../config/ServerConfig.hpp"
+#include "Response.hpp"
+#include <list>
+
+// Directory listings for locations with "autoindex on", as HTML or, with
+// "autoindex_format json", as JSON. A rendered listing is kept in an LRU
+// keyed by the directory's device and inode and reused until the
+// directory's mtime changes, so only the first request after a change reads
+// the directory again.
+class AutoIndex
+{
+	public:
+		// Fills `response` with the listing of `dirPath`, which the request
+		// reached as `urlPath`
+		static Response render(const ServerConfig &config, const LocationConfig &location,
+							const std::string &dirPath, const std::string &urlPath,
+							Response &response);
+
+		static void cleanup();
+
+	private:
+		struct Key
+		{
+			dev_t device;
+			ino_t inode;
+			int format;
+			// Links are absolute, so the same directory under another path
+			// is another listing
+			std::string urlPath;
+
+			bool operator<(const Key &other) const;
+		};
+
+		struct Entry
+		{
+			Key key;
+			time_t mtime;
+			std::string body;
+		};
+
+		struct Item
+		{
+			std::string name;
+			bool isDirectory;
+
+			// Directories first, then by name
+			bool operator<(const Item &other) const;
+		};
+
+		// Most recently used first
+		static std::list<Entry> _lru;
+		static std::map<Key, std::list<Entry>::iterator> _index;
+		static size_t _bytes;
+
+		static bool _read(const std::string &dirPath, std::vector<Item> &items);
+		static void _renderHtml(const std::vector<Item> &items, const std::string &base,
+								std::string &body);
+		static void _renderJson(const std::vector<Item> &items, std::string &body);
+		static void _store(const Key &key, time_t mtime, const std::string &body);
+		static void _erase(std::list<Entry>::iterator entry);
+		static void _updateGauges();
+
+		AutoIndex();
+};
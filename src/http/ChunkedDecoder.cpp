@@ -0,0 +1,118 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChunkedDecoder.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 10:02:11 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 10:02:11 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ChunkedDecoder.hpp"
+
+ChunkedDecoder::ChunkedDecoder() : _state(SIZE), _chunkRemaining(0), _sizeDigits(0) {}
+
+void ChunkedDecoder::reset()
+{
+	_state = SIZE;
+	_chunkRemaining = 0;
+	_sizeDigits = 0;
+}
+
+bool ChunkedDecoder::isDone() const { return _state == DONE; }
+bool ChunkedDecoder::hasError() const { return _state == ERROR; }
+
+static int hexValue(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+size_t ChunkedDecoder::decode(const char *data, size_t len,
+							const char *&chunk, size_t &chunkLen)
+{
+	size_t pos = 0;
+	chunk = NULL;
+	chunkLen = 0;
+
+	while (pos < len && _state != DONE && _state != ERROR)
+	{
+		char c = data[pos];
+		switch (_state)
+		{
+			case SIZE:
+			{
+				int digit = hexValue(c);
+				if (digit >= 0)
+				{
+					// 15 hex digits keep us well clear of size_t overflow
+					if (++_sizeDigits > 15) { _state = ERROR; break; }
+					_chunkRemaining = _chunkRemaining * 16 + digit;
+				}
+				else if (_sizeDigits == 0)
+					_state = ERROR;
+				else if (c == ';' || c == ' ' || c == '\t')
+					_state = SIZE_EXT;
+				else if (c == '\r')
+					_state = SIZE_LF;
+				else
+					_state = ERROR;
+				++pos;
+				break;
+			}
+			case SIZE_EXT:
+				if (c == '\r')
+					_state = SIZE_LF;
+				++pos;
+				break;
+			case SIZE_LF:
+				if (c != '\n') { _state = ERROR; break; }
+				_state = (_chunkRemaining == 0) ? TRAILER : DATA;
+				++pos;
+				break;
+			case DATA:
+			{
+				size_t n = std::min(_chunkRemaining, len - pos);
+				chunk = data + pos;
+				chunkLen = n;
+				_chunkRemaining -= n;
+				pos += n;
+				if (_chunkRemaining == 0)
+					_state = DATA_CR;
+				return pos;
+			}
+			case DATA_CR:
+				_state = (c == '\r') ? DATA_LF : ERROR;
+				++pos;
+				break;
+			case DATA_LF:
+				if (c != '\n') { _state = ERROR; break; }
+				_state = SIZE;
+				_sizeDigits = 0;
+				++pos;
+				break;
+			case TRAILER:
+				// An empty line ends the trailer section; anything else is a
+				// trailer field, which we skip
+				_state = (c == '\r') ? TRAILER_LF : TRAILER_LINE;
+				++pos;
+				break;
+			case TRAILER_LINE:
+				if (c == '\n')
+					_state = TRAILER;
+				++pos;
+				break;
+			case TRAILER_LF:
+				_state = (c == '\n') ? DONE : ERROR;
+				++pos;
+				break;
+			default:
+				break;
+		}
+	}
+	return pos;
+}
@@ -0,0 +1,55 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChunkedDecoder.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 10:02:11 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 10:02:11 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+
+// Incremental decoder for "Transfer-Encoding: chunked" bodies.
+// Bytes can be fed as they arrive from the socket; chunk payloads are handed
+// back as spans pointing into the caller's buffer, so nothing is copied here.
+class ChunkedDecoder
+{
+	public:
+		ChunkedDecoder();
+
+		void reset();
+
+		// Consumes bytes from `data` and returns how many were used. Stops early
+		// whenever a piece of chunk payload is available, which is returned
+		// through `chunk`/`chunkLen` (chunkLen is 0 when there is none).
+		size_t decode(const char *data, size_t len,
+					const char *&chunk, size_t &chunkLen);
+
+		bool isDone() const;
+		bool hasError() const;
+
+	private:
+		enum State
+		{
+			SIZE,
+			SIZE_EXT,
+			SIZE_LF,
+			DATA,
+			DATA_CR,
+			DATA_LF,
+			TRAILER,
+			TRAILER_LINE,
+			TRAILER_LF,
+			DONE,
+			ERROR
+		};
+
+		State _state;
+		size_t _chunkRemaining;
+		size_t _sizeDigits;
+};
@@ -0,0 +1,164 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FileBody.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:22:45 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:22:45 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "FileBody.hpp"
+#include "HttpStatus.hpp"
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
+
+// Bytes sent per writable event, so one large download cannot monopolise
+// the event loop
+static const size_t FILE_SEND_SLICE = 262144;
+
+enum RangeResult
+{
+	RANGE_NONE,
+	RANGE_OK,
+	RANGE_UNSATISFIABLE
+};
+
+// Only a single "bytes=first-last", "bytes=first-" or "bytes=-suffix" is
+// honoured; anything else is ignored and the whole file is sent
+static RangeResult parseRange(const std::string &header, off_t size,
+							off_t &first, off_t &last)
+{
+	if (header.compare(0, 6, "bytes=") != 0 || header.find(',') != std::string::npos)
+		return RANGE_NONE;
+
+	std::string spec = header.substr(6);
+	size_t dash = spec.find('-');
+	if (dash == std::string::npos
+		|| spec.find_first_not_of("0123456789-") != std::string::npos
+		|| spec.find('-', dash + 1) != std::string::npos
+		|| spec.size() == 1)
+		return RANGE_NONE;
+
+	std::string from = spec.substr(0, dash);
+	std::string to = spec.substr(dash + 1);
+
+	if (from.empty()) {
+		off_t suffix = static_cast<off_t>(std::strtoul(to.c_str(), NULL, 10));
+		if (suffix == 0 || size == 0)
+			return RANGE_UNSATISFIABLE;
+		first = (suffix >= size) ? 0 : size - suffix;
+		last = size - 1;
+		return RANGE_OK;
+	}
+
+	first = static_cast<off_t>(std::strtoul(from.c_str(), NULL, 10));
+	last = to.empty() ? size - 1 : static_cast<off_t>(std::strtoul(to.c_str(), NULL, 10));
+	if (first >= size)
+		return RANGE_UNSATISFIABLE;
+	if (last < first)
+		return RANGE_NONE;
+	if (last >= size)
+		last = size - 1;
+	return RANGE_OK;
+}
+
+FileBody::FileBody() : _fd(-1), _offset(0), _remaining(0) {}
+
+FileBody::~FileBody()
+{
+	close();
+}
+
+bool FileBody::open(const ServerConfig &config, const std::string &path,
+					const std::string &range, Response &response)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		if (fd >= 0)
+			::close(fd);
+		HttpStatus::buildResponse(config, response, 404);
+		return false;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	off_t first = 0;
+	off_t last = st.st_size - 1;
+	std::ostringstream header;
+
+	switch (parseRange(range, st.st_size, first, last)) {
+		case RANGE_UNSATISFIABLE:
+			::close(fd);
+			HttpStatus::buildResponse(config, response, 416);
+			header << "bytes */" << st.st_size;
+			response.setHeader("Content-Range", header.str());
+			return false;
+		case RANGE_OK:
+			response.setStatus(206, "Partial Content");
+			header << "bytes " << first << "-" << last << "/" << st.st_size;
+			response.setHeader("Content-Range", header.str());
+			break;
+		case RANGE_NONE:
+			response.setStatus(200, "OK");
+			break;
+	}
+
+	std::ostringstream length;
+	length << (last - first + 1);
+	response.setHeader("Content-Length", length.str());
+	response.setHeader("Accept-Ranges", "bytes");
+
+	_fd = fd;
+	_offset = first;
+	_remaining = last - first + 1;
+	if (_remaining == 0)
+		close();
+	return true;
+}
+
+bool FileBody::send(int socket)
+{
+	size_t count = std::min(_remaining, FILE_SEND_SLICE);
+
+#ifdef __linux__
+	ssize_t n = sendfile(socket, _fd, &_offset, count);
+#else
+	char buffer[65536];
+	ssize_t n = pread(_fd, buffer, std::min(count, sizeof(buffer)), _offset);
+	if (n > 0)
+		n = ::send(socket, buffer, n, 0);
+	if (n > 0)
+		_offset += n;
+#endif
+
+	// NO ERRNO CHECKING - evaluation requirement
+	// A file that shrank under us cannot deliver the promised length either
+	if (n <= 0) {
+		close();
+		return false;
+	}
+	_remaining -= n;
+	if (_remaining == 0)
+		close();
+	return true;
+}
+
+bool FileBody::isOpen() const
+{
+	return _fd >= 0;
+}
+
+void FileBody::close()
+{
+	if (_fd >= 0) {
+		::close(_fd);
+		_fd = -1;
+	}
+	_remaining = 0;
+}
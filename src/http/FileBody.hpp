@@ -0,0 +1,48 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FileBody.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:22:45 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:22:45 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../config/ServerConfig.hpp"
+#include "Response.hpp"
+
+// A response body sent straight from a file descriptor to the socket, with
+// sendfile() where available, so the file never passes through our buffers.
+// Honours a single byte range.
+class FileBody
+{
+	public:
+		FileBody();
+		~FileBody();
+
+		// Opens `path` and fills in the status and length headers for the
+		// request's Range header. Returns false when there is nothing to
+		// stream, with `response` holding the complete error instead.
+		bool open(const ServerConfig &config, const std::string &path,
+				const std::string &range, Response &response);
+
+		// Sends the next slice to `socket`. Returns false when the transfer
+		// failed and the connection has to be dropped.
+		bool send(int socket);
+
+		bool isOpen() const;
+		void close();
+
+	private:
+		int _fd;
+		off_t _offset;
+		size_t _remaining;
+
+		FileBody(const FileBody&);
+		FileBody& operator=(const FileBody&);
+};
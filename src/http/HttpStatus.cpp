@@ -33,10 +33,12 @@ std::string HttpStatus::getMessage(int code)
 		case 415: return "Unsupported Media Type";
 		case 416: return "Range Not Satisfiable";
 		case 422: return "Unprocessable Entity";
+		case 431: return "Request Header Fields Too Large";
 		case 500: return "Internal Server Error";
 		case 501: return "Not Implemented";
 		case 502: return "Bad Gateway";
 		case 503: return "Service Unavailable";
+		case 504: return "Gateway Timeout";
 		default:  return "Unknown Status";
 	}
 }
@@ -54,8 +56,49 @@ std::string HttpStatus::generateHtmlBody(int code)
 	return html.str();
 }
 
+// Only codes with an error_page get their own copy; the generated pages
+// are the same for every server and shared by all of them
+void HttpStatus::prerender(const ServerConfig &config, std::map<int, Response> &responses)
+{
+	responses.clear();
+	const std::map<int, std::string> &errorPage = config.getErrorPage();
+	for (std::map<int, std::string>::const_iterator it = errorPage.begin();
+		it != errorPage.end(); ++it)
+	{
+		Response &response = responses[it->first];
+		response = render(config, it->first);
+		response.freeze();
+	}
+}
+
 Response HttpStatus::buildResponse(const ServerConfig &config, Response &response, int code)
 {
+	const Response *canned = config.getErrorResponse(code);
+	if (canned)
+	{
+		response.setCanned(*canned);
+		return response;
+	}
+
+	// Rendered on first use and kept for the life of the process
+	static std::map<int, Response> generated;
+	std::map<int, Response>::iterator it = generated.find(code);
+	if (it == generated.end())
+	{
+		Response page;
+		page.setStatus(code, getMessage(code));
+		page.setHeader("Content-Type", "text/html");
+		page.setBody(generateHtmlBody(code));
+		page.freeze();
+		it = generated.insert(std::make_pair(code, page)).first;
+	}
+	response.setCanned(it->second);
+	return response;
+}
+
+Response HttpStatus::render(const ServerConfig &config, int code)
+{
+	Response response;
 	const std::map<int, std::string>& errorPage = config.getErrorPage();
 	std::string rootDir = config.getServerRoot();
 
@@ -72,8 +115,7 @@ Response HttpStatus::buildResponse(const ServerConfig &config, Response &respons
 			buffer << file.rdbuf();
 			std::string content = buffer.str();
 
-			std::string contentType = getMimeType(filePath);
-			response.setHeader("Content-Type", contentType);
+			response.setHeader("Content-Type", config.getMimeTypes().lookup(filePath));
 			response.setBody(content);
 
 			response.setStatus(code, getMessage(code));
@@ -23,6 +23,12 @@ class HttpStatus
 	public:
 		static std::string getMessage(int code);
 		static std::string generateHtmlBody(int code);
+		// Error response for `code`: the server's error_page when it has one
+		// for it, otherwise a generated page. Reads the page from disk.
+		static Response render(const ServerConfig &config, int code);
+		// Pre-renders the server's error pages
+		static void prerender(const ServerConfig &config, std::map<int, Response> &responses);
+		// The server's pre-rendered error page, or the generated one
 		static Response buildResponse(const ServerConfig &config, Response &response, int code);
 	private:
 };
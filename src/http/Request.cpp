@@ -12,9 +12,9 @@
 
 #include "Request.hpp"
 
-Request::Request(const std::string &rawRequest) : _isChunked(false)
+Request::Request(const std::string &rawHeaders) : _isChunked(false), _framingError(0)
 {
-	std::istringstream stream(rawRequest);
+	std::istringstream stream(rawHeaders);
 	std::string line;
 
 	// Storing the first line of the request in _method, _path and _httpVerion
@@ -48,35 +48,17 @@ Request::Request(const std::string &rawRequest) : _isChunked(false)
 			key.erase(key.find_last_not_of(" \t\r\n") + 1);
 			value.erase(0, value.find_first_not_of(" \t"));
 			value.erase(value.find_last_not_of(" \t\r\n") + 1);
-			_headers[key] = value;
+			_headers[_canonicalHeaderKey(key)] = value;
 		}
 	}
 
 	_processTransferEncoding();
-
-	// Getting the body
-	std::ostringstream bodyStream;
-	bodyStream << stream.rdbuf();
-	_body = bodyStream.str();
-
-	// If chunked encoding, decode the body
-	if (_isChunked && !_body.empty()) {
-		_body = _decodeChunkedBody(_body);
-
-		// Update Content-Length header
-		std::ostringstream oss;
-		oss << _body.size();
-		_headers["Content-Length"] = oss.str();
-
-		// Remove Transfer-Encoding header
-		_headers.erase("Transfer-Encoding");
-	}
 }
 
 const std::string &Request::getReqMethod() const { return _method; }
 const std::string &Request::getReqPath() const { return _path; }
 const std::string &Request::getReqHttpVersion() const { return _httpVersion; }
-const std::string &Request::getReqBody() const { return _body; }
+const RequestBody &Request::getReqBody() const { return _body; }
 
 const std::string &Request::getReqHeaderKey(const std::string &key) const
 {
@@ -89,63 +71,77 @@ const std::string &Request::getReqHeaderKey(const std::string &key) const
 
 const std::map<std::string, std::string> &Request::getReqHeaders() const
 {
-	std::map<std::string, std::string>::const_iterator it = _headers.begin();
-	while (it != _headers.end())
-	{
-		std::cout << it->first << "|" << it->second << std::endl;
-		it++;
-	}
 	return _headers;
 }
 
 const std::string &Request::getReqQueryString() const { return _queryString; }
 
+// Only a bare "chunked" coding is decoded; any other list of codings is
+// refused with 501. A message framed by both Transfer-Encoding and
+// Content-Length is refused with 400, since a proxy in front of us may have
+// read its length the other way.
 void Request::_processTransferEncoding()
 {
+	if (_headers.find("Transfer-Encoding") == _headers.end())
+		return;
+	if (_headers.find("Content-Length") != _headers.end()) {
+		_framingError = 400;
+		return;
+	}
+
 	std::string transferEncoding = getReqHeaderKey("Transfer-Encoding");
-	if (transferEncoding == "chunked") {
-		_isChunked = true;
+	std::transform(transferEncoding.begin(), transferEncoding.end(),
+		transferEncoding.begin(), ::tolower);
+	if (transferEncoding != "chunked") {
+		_framingError = 501;
+		return;
 	}
+	_isChunked = true;
 }
 
-std::string Request::_decodeChunkedBody(const std::string& chunkedBody)
+bool Request::appendBody(const char *data, size_t len, size_t bufferSize)
 {
-	std::string decodedBody;
-	size_t pos = 0;
-
-	while (pos < chunkedBody.length()) {
-		// Find end of chunk size line
-		size_t crlfPos = chunkedBody.find("\r\n", pos);
-		if (crlfPos == std::string::npos) break;
-
-		// Parse chunk size (hexadecimal)
-		std::string chunkSizeStr = chunkedBody.substr(pos, crlfPos - pos);
-		if (chunkSizeStr.empty()) break;
-
-		size_t chunkSize;
-		try {
-			chunkSize = std::strtoul(chunkSizeStr.c_str(), NULL, 16);
-		} catch (const std::exception&) {
-			break; // Invalid chunk size
-		}
+	return _body.append(data, len, bufferSize);
+}
 
-		// If chunk size is 0, we've reached the end
-		if (chunkSize == 0) break;
+void Request::finalizeBody()
+{
+	if (!_isChunked)
+		return;
+
+	// Downstream handlers only ever see the decoded body
+	std::ostringstream oss;
+	oss << _body.size();
+	_headers["Content-Length"] = oss.str();
+	_headers.erase("Transfer-Encoding");
+}
 
-		// Move to start of chunk data
-		pos = crlfPos + 2;
+bool Request::isChunked() const { return _isChunked; }
+int Request::getFramingError() const { return _framingError; }
 
-		// Ensure we don't read beyond buffer
-		if (pos + chunkSize > chunkedBody.length()) break;
+void Request::setRoute(const LocationMatch &route) { _route = route; }
+const LocationMatch &Request::getRoute() const { return _route; }
 
-		// Extract chunk data
-		decodedBody += chunkedBody.substr(pos, chunkSize);
+void Request::rewrite(const std::string &path, const std::string &queryString)
+{
+	_path = normalizePath(path);
+	_queryString = queryString;
+}
 
-		// Move past chunk data and trailing CRLF
-		pos += chunkSize + 2;
-	}
+// Header names are case-insensitive; store them as "Content-Length" so that
+// lookups with the usual spelling always hit
+std::string Request::_canonicalHeaderKey(const std::string &key)
+{
+	std::string result = key;
+	bool upper = true;
 
-	return decodedBody;
+	for (size_t i = 0; i < result.size(); ++i)
+	{
+		unsigned char c = result[i];
+		result[i] = upper ? std::toupper(c) : std::tolower(c);
+		upper = (c == '-');
+	}
+	return result;
 }
 
 
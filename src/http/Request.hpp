@@ -14,31 +14,51 @@
 
 #include "../../inc/webserv.hpp"
 #include "../utils/Logger.hpp"
+#include "RequestBody.hpp"
+#include "../config/LocationTrie.hpp"
 
 class Request
 {
 	public:
-		Request(const std::string &rawRequest);
+		Request(const std::string &rawHeaders);
 
 	const std::string &getReqMethod() const;
 	const std::string &getReqPath() const;
 	const std::string &getReqHttpVersion() const;
-	const std::string &getReqBody() const;
+	const RequestBody &getReqBody() const;
 	const std::string &getReqHeaderKey(const std::string &key) const;
 	const std::map<std::string, std::string> &getReqHeaders() const;
 	const std::string &getReqQueryString() const;
 	const std::string normalizePath(const std::string &path);
 
+	// The body arrives separately from the header block, already de-chunked.
+	// Past `bufferSize` bytes it is spooled to disk; false if that fails.
+	bool appendBody(const char *data, size_t len, size_t bufferSize);
+	void finalizeBody();
+	bool isChunked() const;
+	// 0, or the status to refuse the request with because its body framing
+	// is unsupported or ambiguous
+	int getFramingError() const;
+
+	// The server's locations matched against the path, once, when the
+	// headers are parsed
+	void setRoute(const LocationMatch &route);
+	// Replaces the path and query string after a rewrite rule matched
+	void rewrite(const std::string &path, const std::string &queryString);
+	const LocationMatch &getRoute() const;
+
 private:
 	std::string _method;
 	std::string _path;
 	std::string _httpVersion;
-	std::string _body;
+	RequestBody _body;
 	std::map<std::string, std::string> _headers;
 	std::string _queryString;
 	bool _isChunked;
-	std::string _decodeChunkedBody(const std::string& chunkedBody);
+	int _framingError;
+	LocationMatch _route;
 	void _processTransferEncoding();
+	static std::string _canonicalHeaderKey(const std::string &key);
 };
 
 // headers will hold
@@ -0,0 +1,91 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RequestBody.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:12:40 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:12:40 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "RequestBody.hpp"
+#include <sys/mman.h>
+
+static const char SPOOL_TEMPLATE[] = "/tmp/webserv-body-XXXXXX";
+
+RequestBody::RequestBody() : _fd(-1), _size(0), _map(NULL) {}
+
+RequestBody::~RequestBody()
+{
+	if (_map)
+		munmap(_map, _size);
+	if (_fd >= 0)
+		::close(_fd);
+}
+
+bool RequestBody::append(const char *data, size_t len, size_t bufferSize)
+{
+	if (_fd < 0 && _memory.size() + len <= bufferSize) {
+		_memory.append(data, len);
+		_size += len;
+		return true;
+	}
+	if (_fd < 0 && !_spill())
+		return false;
+	if (!_write(data, len))
+		return false;
+	_size += len;
+	return true;
+}
+
+size_t RequestBody::size() const { return _size; }
+bool RequestBody::empty() const { return _size == 0; }
+int RequestBody::fd() const { return _fd; }
+
+const char *RequestBody::data() const
+{
+	if (_fd < 0 || _size == 0)
+		return _memory.data();
+	if (!_map) {
+		void *map = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+		if (map == MAP_FAILED)
+			return NULL;
+		_map = map;
+	}
+	return static_cast<const char *>(_map);
+}
+
+// Moves what is in memory so far into a fresh spool file. The file is
+// unlinked at once: it goes away with the descriptor, even after a crash.
+bool RequestBody::_spill()
+{
+	char path[sizeof(SPOOL_TEMPLATE)];
+	std::memcpy(path, SPOOL_TEMPLATE, sizeof(SPOOL_TEMPLATE));
+
+	int fd = mkstemp(path);
+	if (fd < 0)
+		return false;
+	unlink(path);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	_fd = fd;
+
+	if (!_write(_memory.data(), _memory.size()))
+		return false;
+	std::string().swap(_memory);
+	return true;
+}
+
+// The spool is a regular file, so a short write means the disk is full
+bool RequestBody::_write(const char *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(_fd, data, len);
+		if (n <= 0)
+			return false;
+		data += n;
+		len -= n;
+	}
+	return true;
+}
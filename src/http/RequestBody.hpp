@@ -0,0 +1,50 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RequestBody.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:12:40 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:12:40 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+
+// A request body that is held in memory while it is small and spooled to an
+// unlinked temporary file once it outgrows client_body_buffer_size, so a
+// connection never buffers more than that however large the body is.
+class RequestBody
+{
+	public:
+		RequestBody();
+		~RequestBody();
+
+		// Returns false when the spool file cannot be created or written
+		bool append(const char *data, size_t len, size_t bufferSize);
+
+		size_t size() const;
+		bool empty() const;
+		// The spool file, or -1 while the body is in memory. It can be
+		// handed to a child as its stdin.
+		int fd() const;
+		// The whole body as contiguous bytes. A spooled body is mapped from
+		// its file, which costs page cache rather than heap. NULL if that
+		// fails.
+		const char *data() const;
+
+	private:
+		std::string _memory;
+		int _fd;
+		size_t _size;
+		mutable void *_map;
+
+		bool _spill();
+		bool _write(const char *data, size_t len);
+
+		RequestBody(const RequestBody&);
+		RequestBody& operator=(const RequestBody&);
+};
@@ -11,96 +11,300 @@
 /* ************************************************************************** */
 
 #include "RequestHandler.hpp"
+#include <strings.h>
 
 // Helper function to find the best matching location for a request
 const LocationConfig *findMatchingLocation(const Request &request, const ServerConfig &config)
 {
+	(void)config;
+	const LocationConfig *bestMatch = request.getRoute().prefix;
+	if (bestMatch && (bestMatch->getCgis().size() > 0 || !bestMatch->getFastCgiPass().empty()))
+	{
+		return bestMatch;
+	}
+	return NULL;
+}
+
+// True when the request targets a script handled by one of the location's
+// cgi directives. A fastcgi_pass location without any takes every request.
+static bool isCgiRequest(const Request &request, const LocationConfig *location)
+{
+	if (!location)
+		return false;
+	if (!location->getFastCgiPass().empty() && location->getCgis().empty())
+		return true;
+
 	const std::string &path = request.getReqPath();
-	const std::map<std::string, LocationConfig> &locations = config.getLocations();
+	size_t dotPos = path.find_last_of('.');
+	if (dotPos == std::string::npos)
+		return false;
+	return location->getCgis().count(path.substr(dotPos)) > 0;
+}
 
-	// First try exact match
-	if (locations.find(path) != locations.end()) {
-		return &locations.at(path);
+static bool checkBodySize(const Request &request, const ServerConfig &config,
+						Response &response)
+{
+	const std::string &contentLength = request.getReqHeaderKey("Content-Length");
+	if (!contentLength.empty()
+		&& std::strtoul(contentLength.c_str(), NULL, 10) > config.getClientMaxBodySize())
+	{
+		HttpStatus::buildResponse(config, response, 413);
+		return false;
 	}
+	return true;
+}
 
-	// Then try prefix matching
-	const LocationConfig *bestMatch = NULL;
-	size_t bestLength = 0;
+// Rewrites and lookups a request may go through before it settles on a
+// location; more means the rules loop
+static const int MAX_REWRITE_CYCLES = 10;
 
-	for (std::map<std::string, LocationConfig>::const_iterator it = locations.begin();
-		it != locations.end(); ++it)
+static const LocationConfig *rewriteScope(const LocationMatch &match)
+{
+	return match.location ? match.location : match.prefix;
+}
+
+// Runs the server's rewrite rules, then looks the location up and runs its
+// rules, again after every rule that asks for it. Returns false with the
+// redirect, or a 500 for a rewrite loop, in `response`.
+bool RequestHandler::route(Request &request, const ServerConfig &config, Response &response)
+{
+	std::string path = request.getReqPath();
+	std::string args = request.getReqQueryString();
+	int status = 0;
+
+	RewriteProgram::Action action = config.getRewrites().run(path, args, status);
+	LocationMatch match = config.matchLocation(path);
+
+	for (int cycle = 0; action != RewriteProgram::REWRITE_REDIRECT; ++cycle)
 	{
-		const std::string &locPath = it->first;
-		if (path.compare(0, locPath.length(), locPath) == 0)
+		const LocationConfig *location = rewriteScope(match);
+		if (!location || location->getRewrites().empty())
+			break;
+
+		action = location->getRewrites().run(path, args, status);
+		if (action != RewriteProgram::REWRITE_LAST)
+			break;
+
+		if (cycle + 1 >= MAX_REWRITE_CYCLES)
 		{
-			if (locPath.length() > bestLength)
-			{
-				bestLength = locPath.length();
-				bestMatch = &(it->second);
-			}
+			Logger::error("Rewrite cycle while processing " + request.getReqPath());
+			HttpStatus::buildResponse(config, response, 500);
+			return false;
 		}
+		match = config.matchLocation(path);
 	}
-	if (bestMatch && bestMatch->getCgis().size() > 0)
+
+	if (action == RewriteProgram::REWRITE_REDIRECT)
 	{
-		return bestMatch;
+		handleRedirect(response, status, path);
+		return false;
 	}
-	return NULL;
+
+	if (path != request.getReqPath() || args != request.getReqQueryString())
+		request.rewrite(path, args);
+	request.setRoute(match);
+	return true;
 }
 
-Response RequestHandler::handle(const Request &request, const ServerConfig &config)
+// Decides, from the headers alone, whether the request may go on to send its
+// body. On refusal `response` already holds the answer.
+bool RequestHandler::admit(const Request &request, const ServerConfig &config,
+						Response &response)
 {
-	// First find matching location
-	const LocationConfig *location = findMatchingLocation(request, config);
-	LocationConfig inheritedLocation;
-	if (location) {
-		inheritedLocation = location->inheritFromServer(config);
-		location = &inheritedLocation; // <--- Use the inherited location!
+	const std::string &method = request.getReqMethod();
+
+	const LocationConfig *location = request.getRoute().prefix;
+	if (location && location->isInternal())
+	{
+		HttpStatus::buildResponse(config, response, 404);
+		return false;
 	}
 
-	// Check if CGI request
-	if (location)
+	const LocationConfig *cgiLocation = findMatchingLocation(request, config);
+
+	if (isCgiRequest(request, cgiLocation))
 	{
-		std::map<std::string, std::string> cgis = location->getCgis();
-		std::string path = request.getReqPath();
-		size_t dotPos = path.find_last_of('.');
-		if (dotPos != std::string::npos)
+		if (!cgiLocation->allowsMethod(method))
+		{
+			HttpStatus::buildResponse(config, response, 405);
+			return false;
+		}
+
+		// The application server resolves its own scripts, possibly on
+		// another filesystem
+		if (!cgiLocation->getFastCgiPass().empty())
+			return checkBodySize(request, config, response);
+
+		std::string scriptPath = cgiLocation->getEffectiveRoot();
+		std::string relPath = cgiLocation->relativePath(request.getReqPath());
+		if (!scriptPath.empty() && scriptPath[scriptPath.size() - 1] != '/'
+			&& (relPath.empty() || relPath[0] != '/'))
+			scriptPath += "/";
+		scriptPath += relPath;
+
+		struct stat st;
+		if (stat(scriptPath.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
 		{
-			std::string ext = path.substr(dotPos);
-			if (cgis.find(ext) != cgis.end())
-			{
-				std::string locationPrefix = "/cgi-bin/"; // Ideally, get this dynamically
-				if (request.getReqPath().find(locationPrefix) == 0)
-				{
-					std::string scriptRelPath = request.getReqPath().substr(locationPrefix.length());
-					std::string scriptPath = location->getRoot();
-					if (!scriptPath.empty() && scriptPath[scriptPath.size() - 1] != '/')
-						scriptPath += "/";
-					scriptPath += scriptRelPath;
-
-					struct stat st;
-					if (stat(scriptPath.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
-					{
-						Response res;
-						return HttpStatus::buildResponse(config, res, 500);
-					}
-				}
-				try
-				{
-					CgiHandler cgi(request, config, *location);
-					return cgi.execute();
-				}
-				catch (const std::exception &e)
-				{
-					Response errorResponse;
-					return HttpStatus::buildResponse(config, errorResponse, 500);
-				}
-			}
+			HttpStatus::buildResponse(config, response, 404);
+			return false;
 		}
 	}
+	else
+	{
+		if (!request.getRoute().location)
+		{
+			HttpStatus::buildResponse(config, response, 404);
+			return false;
+		}
+
+		const LocationConfig &location = *request.getRoute().location;
+		if (!location.allowsMethod(method))
+		{
+			HttpStatus::buildResponse(config, response, 405);
+			return false;
+		}
+
+		if (!location.getRedirects().empty())
+		{
+			handleRedirectLocation(response, location);
+			return false;
+		}
+	}
+
+	return checkBodySize(request, config, response);
+}
+
+// Launches the CGI script the request targets, if any. Returns false when the
+// request is not a CGI one; otherwise `cgi` is the running handler, or NULL
+// with `response` holding what to send: an error or a cached response.
+// A non-zero `streamedBody` is the length of a body that has not been read
+// yet and is passed to the handler as it arrives.
+bool RequestHandler::startCgi(const Request &request, const ServerConfig &config,
+							CgiHandler *&cgi, Response &response, size_t streamedBody)
+{
+	cgi = NULL;
+	const LocationConfig *match = findMatchingLocation(request, config);
+	if (!isCgiRequest(request, match))
+		return false;
+
+	try
+	{
+		// The handler keeps references: both outlive it with the client
+		cgi = new CgiHandler(request, config, *match);
+		if (streamedBody > 0)
+			cgi->streamBody(streamedBody);
+		if (!cgi->start(response))
+		{
+			delete cgi;
+			cgi = NULL;
+		}
+	}
+	catch (const std::exception &e)
+	{
+		delete cgi;
+		cgi = NULL;
+		HttpStatus::buildResponse(config, response, 500);
+	}
+	return true;
+}
+
+// Maps the target of X-Accel-Redirect (a URI inside an internal location) or
+// X-Sendfile (a filesystem path under an internal location's root) to the
+// file to send
+static bool resolveInternalFile(const ServerConfig &config, const Response &head,
+								std::string &file)
+{
+	const std::string &uri = head.getHeader("X-Accel-Redirect");
+	if (!uri.empty())
+	{
+		std::string path = uri.substr(0, uri.find('?'));
+		if (path.empty() || path[0] != '/' || path.find("/../") != std::string::npos
+			|| endsWith(path, "/.."))
+			return false;
+
+		const LocationConfig *location = config.matchLocation(path).prefix;
+		if (!location || !location->isInternal())
+			return false;
+
+		file = location->getEffectiveRoot();
+		std::string relPath = location->relativePath(path);
+		if (!file.empty() && file[file.size() - 1] != '/'
+			&& (relPath.empty() || relPath[0] != '/'))
+			file += "/";
+		file += relPath;
+		return true;
+	}
+
+	char resolved[PATH_MAX];
+	if (!realpath(head.getHeader("X-Sendfile").c_str(), resolved))
+		return false;
+	std::string path(resolved);
+
+	const std::map<std::string, LocationConfig> &locations = config.getLocations();
+	for (std::map<std::string, LocationConfig>::const_iterator it = locations.begin();
+		it != locations.end(); ++it)
+	{
+		const std::string &root = it->second.getEffectiveRoot();
+		char rootResolved[PATH_MAX];
+		if (!it->second.isInternal() || !realpath(root.c_str(), rootResolved))
+			continue;
+
+		std::string prefix(rootResolved);
+		if (prefix[prefix.size() - 1] != '/')
+			prefix += "/";
+		if (path.compare(0, prefix.size(), prefix) == 0)
+		{
+			file = path;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Answers a CGI request whose script named a file to send instead of a body.
+// Headers describing the download are kept from the script's response.
+void RequestHandler::serveInternal(const Request &request, const ServerConfig &config,
+								const Response &head, Response &response, FileBody &file)
+{
+	static const char *kept[] = {
+		"Content-Type", "Content-Disposition", "Cache-Control", "Expires", "Set-Cookie", "Last-Modified", NULL
+	};
+
+	std::string path;
+	if (!resolveInternalFile(config, head, path))
+	{
+		Logger::warn("Internal redirect to a file outside internal locations refused");
+		HttpStatus::buildResponse(config, response, 404);
+		return;
+	}
+	if (!file.open(config, path, request.getReqHeaderKey("Range"), response))
+		return;
+
+	const std::map<std::string, std::string> &headers = head.getHeaders();
+	for (std::map<std::string, std::string>::const_iterator it = headers.begin();
+		it != headers.end(); ++it)
+	{
+		for (size_t i = 0; kept[i]; ++i)
+		{
+			if (strcasecmp(it->first.c_str(), kept[i]) == 0)
+				response.setHeader(kept[i], it->second);
+		}
+	}
+	if (response.getHeader("Content-Type").empty())
+		response.setHeader("Content-Type", config.getMimeTypes().lookup(path));
+}
+
+Response RequestHandler::handle(const Request &request, const ServerConfig &config,
+								FileBody &file)
+{
+	const LocationConfig *location = request.getRoute().location;
+	if (location && location->isMetrics()
+		&& request.getReqMethod() == "GET")
+		return handleMetrics();
 
 	// Handle standard methods...
 	if (request.getReqMethod() == "GET" && isMethodAllowed(request, config, "GET"))
-		return handleGetMethod(request, config);
+		return handleGetMethod(request, config, file);
 	else if (request.getReqMethod() == "POST" && isMethodAllowed(request, config, "POST"))
 		return handlePostMethod(request, config);
 	else if (request.getReqMethod() == "DELETE" && isMethodAllowed(request, config, "DELETE"))
@@ -112,67 +316,62 @@ Response RequestHandler::handle(const Request &request, const ServerConfig &conf
 	}
 }
 
+Response RequestHandler::handleMetrics()
+{
+	Response response;
+	response.setStatus(200, "OK");
+	response.setHeader("Content-Type", "text/plain");
+	response.setHeader("Cache-Control", "no-store");
+	response.setBody(Metrics::render());
+	return response;
+}
+
 // ============
 // GET METHOD
 // ============
-Response RequestHandler::handleGetMethod(const Request &request, const ServerConfig &config)
+Response RequestHandler::handleGetMethod(const Request &request, const ServerConfig &config,
+										FileBody &file)
 {
 	Response response;
 
-	std::string reqPath = request.getReqPath();
-	std::string rootDir = config.getServerRoot();
-	std::vector<std::string> indexes = config.getServerIndexes();
-	std::string locationPrefix = extractLocationPrefix(request, config);
-	std::string locationRootDir = config.getLocations().at(locationPrefix).getRoot();
-	bool locationAutoIndex = config.getLocations().at(locationPrefix).isAutoIndex();
-	std::vector<std::string> locationIndex = config.getLocations().at(locationPrefix).getIndexes();
-	std::map<int, std::string> locationRedirects = config.getLocations().at(locationPrefix).getRedirects();
+	const LocationConfig &location = *request.getRoute().location;
+	const std::vector<std::string> &locationIndex = location.getIndexes();
+	bool locationAutoIndex = location.isAutoIndex();
 	bool serverAutoIndex = config.getServerAutoIndex();
 
-	reqPath = normalizeReqPath(reqPath);
-
-	if (!locationRedirects.empty())
-		return handleRedirectLocation(response, locationRedirects);
+	std::string reqPath = normalizeReqPath(request.getReqPath());
 
-	if (locationRootDir[0] == '.')
-		locationRootDir.erase(0, locationRootDir.find_first_not_of("."));
+	if (!location.getRedirects().empty())
+		return handleRedirectLocation(response, location);
 
 	if (reqPath == "/")
 	{
-		std::string indexFile = resolveMultipleIndexes(rootDir, indexes);
+		std::string indexFile = resolveMultipleIndexes(config.getServerRoot(), config.getServerIndexes());
 		if (indexFile.empty())
 			return HttpStatus::buildResponse(config,response, 403);
 		reqPath = "/" + indexFile;
 	}
 
-	if (locationPrefix != "/")
-		reqPath = reqPath.substr(locationPrefix.length());
+	reqPath = location.relativePath(reqPath);
 
 	std::string fullPath;
 
 	if (!locationIndex.empty() && reqPath.empty())
-		fullPath = rootDir + locationRootDir + reqPath + "/" + locationIndex.at(0);
+		fullPath = location.getDocumentRoot() + "/" + locationIndex.at(0);
 	else
-		fullPath = rootDir + locationRootDir + reqPath;
+		fullPath = location.getDocumentRoot() + reqPath;
 
-	std::ifstream file(fullPath.c_str());
-
-	if (!file)
-		return HttpStatus::buildResponse(config,response, 404);
-
-	if ((isDirectory(fullPath) && locationAutoIndex == 1)
-		|| (isDirectory(fullPath) && serverAutoIndex == true))
-		return generateAutoIndexPage(config, response, fullPath, locationPrefix);
-	else if (isDirectory(fullPath) && locationAutoIndex == 0)
+	if (isDirectory(fullPath))
+	{
+		if (locationAutoIndex || serverAutoIndex)
+			return AutoIndex::render(config, location, fullPath, request.getReqPath(), response);
 		return HttpStatus::buildResponse(config, response, 403);
+	}
 
-	std::ostringstream ss;
-	ss << file.rdbuf();
-
-	std::string contentType = getMimeType(fullPath);
-	response.setStatus(200, "OK");
-	response.setBody(ss.str());
-	response.setHeader("Content-Type", contentType);
+	// Sent by the client from the file itself, ranges included
+	if (!file.open(config, fullPath, request.getReqHeaderKey("Range"), response))
+		return response;
+	response.setHeader("Content-Type", config.getMimeTypes().lookup(fullPath));
 	return response;
 }
 
@@ -202,12 +401,7 @@ Response RequestHandler::handleMultipartPost(const Request &request, const Serve
 	Response response;
 
 	std::string reqPath = request.getReqPath();
-	std::string rootDir = config.getServerRoot();
-	std::string locationPrefix = extractLocationPrefix(request, config);
-	std::string locationRootDir = config.getLocations().at(locationPrefix).getRoot();
-
-	if (locationRootDir[0] == '.')
-		locationRootDir.erase(0, locationRootDir.find_first_not_of("."));
+	const std::string &documentRoot = request.getRoute().location->getDocumentRoot();
 
 	if (reqPath.find("..") != std::string::npos)
 		return HttpStatus::buildResponse(config,response, 403);
@@ -228,29 +422,42 @@ Response RequestHandler::handleMultipartPost(const Request &request, const Serve
 		if (!it->fileName.empty())
 		{
 			std::string updatedFileName = generateTimestampFilename(it->fileName);
-			std::string fullPath = rootDir + locationRootDir + "/" + updatedFileName;
+			std::string fullPath = documentRoot + "/" + updatedFileName;
 
 			std::ofstream out(fullPath.c_str(), std::ios::binary);
 			if (!out)
 				return HttpStatus::buildResponse(config,response, 500);
 
-			out.write(it->content.data(), it->content.size());
+			out.write(it->content, it->contentLength);
 			out.close();
 		}
 		else
 		{
 			std::cout << "Key->" << it->name << std::endl;
-			std::cout << "Value->" << std::string(it->content.begin(), it->content.end()) << "\n\n";
+			std::cout << "Value->" << std::string(it->content, it->contentLength) << "\n\n";
 		}
 	}
 	return HttpStatus::buildResponse(config,response, 200);
 }
 
+// std::string::find over a body that may be mapped from its spool file
+static size_t findBytes(const char *data, size_t size, const std::string &needle, size_t from)
+{
+	if (from > size)
+		return std::string::npos;
+	const char *end = data + size;
+	const char *hit = std::search(data + from, end, needle.begin(), needle.end());
+	return (hit == end) ? std::string::npos : static_cast<size_t>(hit - data);
+}
+
 std::vector<MultipartPart> parseMultiparts(const Request &request)
 {
 	std::vector<MultipartPart> parts;
 
-	const std::string &body = request.getReqBody();
+	const char *body = request.getReqBody().data();
+	size_t bodySize = request.getReqBody().size();
+	if (!body)
+		return parts;
 	std::string contentType = request.getReqHeaderKey("Content-Type");
 
 	size_t boundaryPos = contentType.find('=');
@@ -264,27 +471,29 @@ std::vector<MultipartPart> parseMultiparts(const Request &request)
 	while (true)
 	{
 		// Find the next boundary
-		size_t boundaryStart = body.find(boundary, pos);
+		size_t boundaryStart = findBytes(body, bodySize, boundary, pos);
 		if (boundaryStart == std::string::npos)
 			break;
 
 		// Skip the boundary and next \r\n
 		pos = boundaryStart + boundary.length();
-		if (body.substr(pos, 2) == "--")
+		if (bodySize - pos >= 2 && body[pos] == '-' && body[pos + 1] == '-')
 			break; // End boundary
 
-		if (body.substr(pos, 2) == "\r\n")
+		if (bodySize - pos >= 2 && body[pos] == '\r' && body[pos + 1] == '\n')
 			pos += 2;
 
 		// Find headers
-		size_t headerEnd = body.find("\r\n\r\n", pos);
+		size_t headerEnd = findBytes(body, bodySize, "\r\n\r\n", pos);
 		if (headerEnd == std::string::npos)
 			break;
 
-		std::string headers = body.substr(pos, headerEnd - pos);
+		std::string headers(body + pos, headerEnd - pos);
 		pos = headerEnd + 4; // move to body
 
 		MultipartPart part;
+		part.content = NULL;
+		part.contentLength = 0;
 		std::istringstream headerStream(headers);
 		std::string headerLine;
 		while (std::getline(headerStream, headerLine))
@@ -299,16 +508,17 @@ std::vector<MultipartPart> parseMultiparts(const Request &request)
 		}
 
 		// Find next boundary to determine content range
-		size_t nextBoundary = body.find(boundary, pos);
+		size_t nextBoundary = findBytes(body, bodySize, boundary, pos);
 		if (nextBoundary == std::string::npos)
 			break;
 
 		size_t contentLen = nextBoundary - pos;
-		part.content = std::vector<char>(body.begin() + pos, body.begin() + pos + contentLen);
+		part.content = body + pos;
+		part.contentLength = contentLen;
 
 		// Trim trailing \r\n from content if present
 		if (contentLen >= 2 && part.content[contentLen - 2] == '\r' && part.content[contentLen - 1] == '\n')
-			part.content.resize(contentLen - 2);
+			part.contentLength = contentLen - 2;
 
 		parts.push_back(part);
 		pos = nextBoundary;
@@ -322,7 +532,8 @@ Response RequestHandler::handleFormPost(const Request &request, const ServerConf
 	Response response;
 
 	std::string reqPath = request.getReqPath();
-	std::string body = request.getReqBody();
+	const char *data = request.getReqBody().data();
+	std::string body = data ? std::string(data, request.getReqBody().size()) : "";
 
 	if (reqPath.find("..") != std::string::npos)
 		return HttpStatus::buildResponse(config,response, 403);
@@ -362,13 +573,8 @@ Response RequestHandler::handleBinaryPost(const Request &request, const ServerCo
 	Response response;
 
 	std::string reqPath = request.getReqPath();
-	std::string body = request.getReqBody();
-	std::string rootDir = config.getServerRoot();
-	std::string locationPrefix = extractLocationPrefix(request, config);
-	std::string locationRootDir = config.getLocations().at(locationPrefix).getRoot();
-
-	if (locationRootDir[0] == '.')
-		locationRootDir.erase(0, locationRootDir.find_first_not_of("."));
+	const RequestBody &body = request.getReqBody();
+	const std::string &documentRoot = request.getRoute().location->getDocumentRoot();
 
 	if (reqPath.find("..") != std::string::npos)
 		return HttpStatus::buildResponse(config,response, 403);
@@ -376,13 +582,16 @@ Response RequestHandler::handleBinaryPost(const Request &request, const ServerCo
 	std::string fileName = extractFilenameFromPath(reqPath);
 	std::string updatedFileName = generateTimestampFilename(fileName);
 
-	std::string fullPath = rootDir + locationRootDir + "/" + updatedFileName;
+	if (!body.data())
+		return HttpStatus::buildResponse(config,response, 500);
+
+	std::string fullPath = documentRoot + "/" + updatedFileName;
 	std::ofstream out(fullPath.c_str(), std::ios::binary);
 
 	if (!out)
 		return HttpStatus::buildResponse(config,response, 500);
 
-	out.write(body.c_str(), body.size());
+	out.write(body.data(), body.size());
 	out.close();
 
 	return HttpStatus::buildResponse(config,response, 200);
@@ -395,22 +604,13 @@ Response RequestHandler::handleDeleteMethod(const Request &request, const Server
 {
 	Response response;
 
-	std::string reqPath = request.getReqPath();
-	std::string rootDir = config.getServerRoot();
-	std::string locationPrefix = extractLocationPrefix(request, config);
-	std::string locationRootDir = config.getLocations().at(locationPrefix).getRoot();
-
-	if (locationRootDir[0] == '.')
-		locationRootDir.erase(0, locationRootDir.find_first_not_of("."));
-
 	// Strip location prefix if needed
-	if (locationPrefix != "/")
-		reqPath = reqPath.substr(locationPrefix.length());
+	std::string reqPath = request.getRoute().location->relativePath(request.getReqPath());
 
 	if (reqPath.find("..") != std::string::npos)
 		return HttpStatus::buildResponse(config,response, 403);
 
-	std::string fullPath = rootDir + locationRootDir + reqPath;
+	std::string fullPath = request.getRoute().location->getDocumentRoot() + reqPath;
 
 	std::ifstream file(fullPath.c_str());
 	if (!file)
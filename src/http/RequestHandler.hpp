@@ -16,15 +16,29 @@
 #include "Response.hpp"
 #include "../config/ServerConfig.hpp"
 #include "HttpStatus.hpp"
+#include "FileBody.hpp"
+#include "AutoIndex.hpp"
 #include "../cgi/CgiHandler.hpp"
+#include "../utils/Metrics.hpp"
 
 class RequestHandler
 {
 	public:
-		static Response handle(const Request &request, const ServerConfig &config);
-		static Response handleGetMethod(const Request &request, const ServerConfig &config);
+		static bool route(Request &request, const ServerConfig &config, Response &response);
+		static bool admit(const Request &request, const ServerConfig &config, Response &response);
+		static bool startCgi(const Request &request, const ServerConfig &config,
+							CgiHandler *&cgi, Response &response, size_t streamedBody);
+		// A static file found by GET is left open in `file` to be streamed
+		// after the returned headers
+		static Response handle(const Request &request, const ServerConfig &config,
+							FileBody &file);
+		static Response handleGetMethod(const Request &request, const ServerConfig &config,
+										FileBody &file);
 		static Response handlePostMethod(const Request &request, const ServerConfig &config);
 		static Response handleDeleteMethod(const Request &request, const ServerConfig &config);
+		static Response handleMetrics();
+		static void serveInternal(const Request &request, const ServerConfig &config,
+								const Response &head, Response &response, FileBody &file);
 
 		// POST Content-Types
 		static Response handleMultipartPost(const Request &request, const ServerConfig &config);
@@ -36,13 +50,13 @@ class RequestHandler
 struct MultipartPart
 {
 	std::string name;
-	std::vector<char> content;
+	// Points into the request body, which outlives the parts
+	const char *content;
+	size_t contentLength;
 	std::string fileName;
 	std::string contentType;
 };
 
-// Multipurpose Internet Mail Extensions =>  MIME
-std::string getMimeType(const std::string &extension);
 bool endsWith(const std::string &str, const std::string &suffix);
 
 // Handling multiple indexes of server indexes
@@ -53,10 +67,8 @@ std::string generateTimestampFilename(std::string &fileName);
 
 // Validating the location and the allowed methods on the specific location
 bool isMethodAllowed(const Request &request, const ServerConfig &config, const std::string &method);
-std::string extractLocationPrefix(const Request &request, const ServerConfig &config);
 std::string extractFilenameFromPath(const std::string &path);
 std::vector<MultipartPart> parseMultiparts(const Request &request);
-void finalizePart(std::vector<MultipartPart> &parts, MultipartPart &part, std::vector<char> &buffer);
 
 void parseContentDisposition(const std::string &line, MultipartPart &part);
 
@@ -64,6 +76,6 @@ bool isDirectory(const std::string &path);
 
 std::string normalizeReqPath(const std::string &path);
 
-Response generateAutoIndexPage(const ServerConfig &config, Response &response, const std::string &dirPath, const std::string &reqPath);
 
-Response &handleRedirectLocation(Response &response, std::map<int, std::string> &locationRedirects);
+Response &handleRedirectLocation(Response &response, const LocationConfig &location);
+Response &handleRedirect(Response &response, int code, const std::string &link);
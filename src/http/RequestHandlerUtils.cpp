@@ -54,26 +54,6 @@ std::string resolveMultipleIndexes(const std::string &rootDir, const std::vector
 	return "";
 }
 
-std::string getMimeType(const std::string &extension)
-{
-	if (endsWith(extension, ".html"))
-		return "text/html";
-	if (endsWith(extension, ".txt"))
-		return "text/plain";
-	if (endsWith(extension, ".jpg") || endsWith(extension, ".jpeg"))
-		return "image/jpeg";
-	if (endsWith(extension, ".css"))
-		return "text/css";
-	if (endsWith(extension, ".js"))
-		return "application/javascript";
-	if (endsWith(extension, ".png"))
-		return "image/png";
-	if (endsWith(extension, ".gif"))
-		return "image/gif";
-
-	return "application/octet-stream";
-}
-
 bool endsWith(const std::string &str, const std::string &suffix)
 {
 	if (str.length() < suffix.length())
@@ -81,35 +61,6 @@ bool endsWith(const std::string &str, const std::string &suffix)
 	return str.compare(str.length() - suffix.length(), suffix.length(), suffix) == 0;
 }
 
-std::string extractLocationPrefix(const Request &request, const ServerConfig &config)
-{
-	const std::map<std::string, LocationConfig> &locations = config.getLocations();
-	std::string reqPath = request.getReqPath();
-
-	std::string bestMatch = "";
-	size_t bestMatchLength = 0;
-
-	for (std::map<std::string, LocationConfig>::const_iterator it = locations.begin(); it != locations.end(); ++it)
-	{
-		const std::string &locationPath = it->first;
-
-		if (reqPath.compare(0, locationPath.length(), locationPath) == 0 &&
-			(reqPath.length() == locationPath.length() || reqPath[locationPath.length()] == '/' || locationPath == "/"))
-		{
-			if (locationPath.length() > bestMatchLength)
-			{
-				bestMatch = locationPath;
-				bestMatchLength = locationPath.length();
-			}
-		}
-	}
-
-	if (bestMatch.empty())
-		return locations.count("/") ? "/" : "";
-
-	return bestMatch;
-}
-
 std::string extractFilenameFromPath(const std::string &path)
 {
 	size_t pos = path.find_last_of('/');
@@ -120,34 +71,12 @@ std::string extractFilenameFromPath(const std::string &path)
 
 bool isMethodAllowed(const Request &request, const ServerConfig &config, const std::string &method)
 {
-	const std::map<std::string, LocationConfig> &locations = config.getLocations();
-
-	std::string locationPrefix = extractLocationPrefix(request, config);
-
-	std::map<std::string, LocationConfig>::const_iterator it = locations.find(locationPrefix);
-
-	if (it == locations.end())
+	(void)config;
+	const LocationConfig *location = request.getRoute().location;
+	if (!location)
 		return false;
 
-	const std::vector<std::string> &methods = it->second.getAllowedMethods();
-
-	for (size_t i = 0; i < methods.size(); ++i)
-	{
-		if (methods[i] == method)
-			return true;
-	}
-	return false;
-}
-
-void finalizePart(std::vector<MultipartPart> &parts, MultipartPart &part, std::vector<char> &buffer)
-{
-	if (!part.name.empty() || !buffer.empty())
-	{
-		part.content = buffer;
-		parts.push_back(part);
-		part = MultipartPart();
-		buffer.clear();
-	}
+	return location->allowsMethod(method);
 }
 
 void parseContentDisposition(const std::string &line, MultipartPart &part)
@@ -191,11 +120,15 @@ std::string normalizeReqPath(const std::string &path)
 
 #include <sstream>
 
-Response &handleRedirectLocation(Response &response, std::map<int, std::string> &locationRedirects)
+// Location redirects are rendered when the config is loaded
+Response &handleRedirectLocation(Response &response, const LocationConfig &location)
 {
-	int code = locationRedirects.begin()->first;
-	std::string link = locationRedirects.begin()->second;
+	response.setCanned(location.getRedirectResponse());
+	return response;
+}
 
+Response &handleRedirect(Response &response, int code, const std::string &link)
+{
 	// Convert code to string
 	std::stringstream ss;
 	ss << code;
@@ -220,70 +153,3 @@ Response &handleRedirectLocation(Response &response, std::map<int, std::string>
 
 	return response;
 }
-
-Response generateAutoIndexPage(const ServerConfig &config, Response &response, 
-    const std::string &dirPath, const std::string &reqPath)
-{
-	DIR *dir = opendir(dirPath.c_str());
-	if (!dir)
-		return HttpStatus::buildResponse(config, response, 403);
-
-	std::string html = "<html><head><title>Index of " + reqPath + "</title></head><body>";
-	html += "<h1>Index of " + reqPath + "</h1><ul>";
-
-	// std::cout << "dirPath-> " << dirPath << std::endl;
-	// std::cout << "reqPath-> " << reqPath << std::endl;
-
-	struct dirent *entry;
-	while ((entry = readdir(dir)) != NULL)
-	{
-		std::string name(entry->d_name);
-		if (name == ".")
-			continue;
-
-		std::string fullEntryPath = dirPath;
-		if (fullEntryPath[fullEntryPath.size() - 1] != '/')
-			fullEntryPath += "/";
-		fullEntryPath += name;
-
-		struct stat st;
-		bool isDir = false;
-		if (stat(fullEntryPath.c_str(), &st) == 0)
-			isDir = S_ISDIR(st.st_mode);
-
-		// Build correct HTTP path even if we're in a subdirectory
-		std::string relativePath = dirPath.substr(std::string("./pages").size()); // strip ./pages
-		if (relativePath.empty())
-			relativePath = "/";
-		else if (relativePath[0] != '/')
-			relativePath = "/" + relativePath;
-
-		std::string linkPath = reqPath;
-		if (linkPath.empty() || linkPath[linkPath.size() - 1] != '/')
-			linkPath += "/";
-		if (relativePath.size() > 1)
-		{
-			linkPath += relativePath.substr(1);
-			if (linkPath[linkPath.size() - 1] != '/')
-				linkPath += "/";
-		}
-		linkPath += name;
-
-		if (isDir)
-		{
-			linkPath += "/";
-			name += "/";
-		}
-
-		// std::cout << "linkPath -> " << linkPath << std::endl;
-		html += "<li><a href=\"" + linkPath + "\">" + name + "</a></li>";
-	}
-
-	closedir(dir);
-	html += "</ul></body></html>";
-	response.setStatus(200, "OK");
-	response.setHeader("Content-Type", "text/html");
-	response.setBody(html);
-	return response;
-}
-
@@ -12,21 +12,24 @@
 
 #include "Response.hpp"
 
-Response::Response() : _statusCode(200), _statusMessage("OK") {}
+Response::Response() : _statusCode(200), _statusMessage("OK"), _canned(NULL) {}
 
 void Response::setStatus(int code, const std::string &message)
 {
+	_materialize();
 	_statusCode = code;
 	_statusMessage = message;
 }
 
 void Response::setHeader(const std::string &key, const std::string &value)
 {
+	_materialize();
 	_headers[key] = value;
 }
 
 void Response::setBody(const std::string &body)
 {
+	_materialize();
 	_body = body;
 
 	std::ostringstream oss;
@@ -34,26 +37,106 @@ void Response::setBody(const std::string &body)
 	_headers["Content-Length"] = oss.str();
 }
 
+void Response::freeze()
+{
+	_materialize();
+	std::string wire;
+	appendTo(wire);
+	_wire = wire;
+}
+
+void Response::setCanned(const Response &frozen)
+{
+	_canned = &frozen;
+	_headers.clear();
+	_body.clear();
+	_wire.clear();
+}
+
 std::string Response::toString() const
 {
-	std::ostringstream responseStream;
+	std::string out;
+	appendTo(out);
+	return out;
+}
 
-	responseStream << "HTTP/1.1 " << _statusCode << " " << _statusMessage << "\r\n";
+// Status line and headers only, for responses whose body is streamed
+std::string Response::toHeaderString() const
+{
+	std::string out;
+	_appendHead(out);
+	return out;
+}
 
-	// Add regular headers first
-	for (std::map<std::string, std::string>::const_iterator it = _headers.begin();
-		it != _headers.end(); ++it)
+void Response::appendTo(std::string &out) const
+{
+	const Response &view = _view();
+	if (!view._wire.empty())
 	{
-		responseStream << it->first << ": " << it->second << "\r\n";
+		out += view._wire;
+		return;
 	}
+	_appendHead(out);
+	out += view._body;
+}
 
-	responseStream << "\r\n";
-	responseStream << _body;
+const std::string &Response::getHeader(const std::string &key) const
+{
+	static const std::string empty = "";
+	const std::map<std::string, std::string> &headers = _view()._headers;
+	std::map<std::string, std::string>::const_iterator it = headers.find(key);
+	if (it != headers.end())
+		return it->second;
+	return empty;
+}
 
-	return responseStream.str();
+const std::map<std::string, std::string> &Response::getHeaders() const
+{
+	return _view()._headers;
+}
+
+void Response::removeHeader(const std::string &key)
+{
+	_materialize();
+	_headers.erase(key);
 }
 
 int Response::getStatusCode() const
 {
-	return _statusCode;
+	return _view()._statusCode;
+}
+
+const Response &Response::_view() const
+{
+	return _canned ? *_canned : *this;
+}
+
+// Turns a canned response back into an ordinary copy before it changes
+void Response::_materialize()
+{
+	if (_canned)
+	{
+		const Response &frozen = *_canned;
+		_canned = NULL;
+		_statusCode = frozen._statusCode;
+		_statusMessage = frozen._statusMessage;
+		_headers = frozen._headers;
+		_body = frozen._body;
+	}
+	_wire.clear();
+}
+
+void Response::_appendHead(std::string &out) const
+{
+	const Response &view = _view();
+	std::ostringstream status;
+	status << view._statusCode;
+
+	out += "HTTP/1.1 " + status.str() + " " + view._statusMessage + "\r\n";
+	for (std::map<std::string, std::string>::const_iterator it = view._headers.begin();
+		it != view._headers.end(); ++it)
+	{
+		out += it->first + ": " + it->second + "\r\n";
+	}
+	out += "\r\n";
 }
@@ -23,12 +23,34 @@ class Response
 		void setHeader(const std::string &key, const std::string &value);
 		void setBody(const std::string &body);
 
+		void removeHeader(const std::string &key);
+
+		// Serializes the response once so that copies of it can be sent
+		// without formatting anything again
+		void freeze();
+		// Makes this response stand for `frozen`, which must outlive it.
+		// Nothing is copied unless the response is modified afterwards.
+		void setCanned(const Response &frozen);
+
 		std::string toString() const;
+		std::string toHeaderString() const;
+		// Appends the serialized response to an output buffer
+		void appendTo(std::string &out) const;
 		int getStatusCode() const;
+		const std::string &getHeader(const std::string &key) const;
+		const std::map<std::string, std::string> &getHeaders() const;
 
 	private:
 		int _statusCode;
 		std::string _statusMessage;
 		std::map<std::string, std::string> _headers;
 		std::string _body;
+		// The frozen response this one stands for, if any
+		const Response *_canned;
+		// Serialized form of a frozen response
+		std::string _wire;
+
+		const Response &_view() const;
+		void _materialize();
+		void _appendHead(std::string &out) const;
 };
@@ -17,19 +17,25 @@ int main(int argc, char** argv)
 {
 	try
 	{
-		if (argc > 2)
+		// -t: check the configuration and exit, as "nginx -t" does
+		bool checkOnly = argc > 1 && std::string(argv[1]) == "-t";
+		int first = checkOnly ? 2 : 1;
+
+		if (argc > first + 1)
 		{
 			throw std::runtime_error("Too many arguments. Usage: " +
-									std::string(argv[0]) + " [config_file]");
+									std::string(argv[0]) + " [-t] [config_file]");
 		}
 
-		std::string configPath = (argc == 2) ? argv[1] : "./config/valid/default.conf";
-		if (argc == 1)
+		std::string configPath = (argc == first + 1) ? argv[first] : "./config/valid/default.conf";
+		if (argc == first)
 		{
 			Logger::warn("No configuration file provided. Using default: default.conf");
 		}
 
 		WebServer webServer(configPath);
+		if (checkOnly)
+			return webServer.check() ? EXIT_SUCCESS : EXIT_FAILURE;
 		webServer.run();
 	}
 	catch (const std::exception& e)
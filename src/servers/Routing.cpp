@@ -0,0 +1,103 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Routing.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 11:42:07 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 11:42:07 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Routing.hpp"
+#include "../config/ConfigParser.hpp"
+#include "../cgi/CgiCache.hpp"
+#include "../cgi/CgiLimiter.hpp"
+
+Routing *Routing::_current = NULL;
+
+Routing::Routing() : _refs(1) {}
+
+// The CGI caches and limits are keyed by location address, which a later
+// configuration may reuse
+Routing::~Routing()
+{
+	for (size_t i = 0; i < _servers.size(); ++i) {
+		const std::map<std::string, LocationConfig> &locations = _servers[i].getLocations();
+		for (std::map<std::string, LocationConfig>::const_iterator it = locations.begin();
+			it != locations.end(); ++it) {
+			CgiCache::forget(it->second);
+			CgiLimiter::forget(it->second);
+		}
+	}
+}
+
+Routing *Routing::load(const std::string &configPath)
+{
+	Routing *routing = new Routing();
+	try
+	{
+		ConfigParser parser(configPath);
+		parser.parse(routing->_servers);
+		if (routing->_servers.empty())
+			throw std::runtime_error("No server configurations found");
+
+		// Name conflicts between blocks sharing an address are caught here
+		for (size_t i = 0; i < routing->_servers.size(); ++i) {
+			const ServerConfig &config = routing->_servers[i];
+			const std::map<std::string, ListenConfig> &listens = config.getListens();
+			for (std::map<std::string, ListenConfig>::const_iterator it = listens.begin();
+				it != listens.end(); ++it) {
+				routing->_listens.insert(*it);
+				routing->_hosts[it->first].add(config, it->second.isDefaultServer(), it->first);
+			}
+		}
+	}
+	catch (...)
+	{
+		delete routing;
+		throw;
+	}
+	return routing;
+}
+
+Routing *Routing::current()
+{
+	return _current;
+}
+
+void Routing::install(Routing *routing)
+{
+	Routing *previous = _current;
+	_current = routing;
+	if (previous)
+		previous->release();
+}
+
+void Routing::retain()
+{
+	++_refs;
+}
+
+void Routing::release()
+{
+	if (--_refs == 0)
+		delete this;
+}
+
+const std::deque<ServerConfig> &Routing::getServers() const
+{
+	return _servers;
+}
+
+const std::map<std::string, ListenConfig> &Routing::getListens() const
+{
+	return _listens;
+}
+
+const VirtualHosts *Routing::findHosts(const std::string &address) const
+{
+	std::map<std::string, VirtualHosts>::const_iterator it = _hosts.find(address);
+	return it == _hosts.end() ? NULL : &it->second;
+}
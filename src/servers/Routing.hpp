@@ -0,0 +1,58 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Routing.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 11:42:07 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 11:42:07 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../config/ServerConfig.hpp"
+#include "VirtualHosts.hpp"
+#include <deque>
+
+// One loaded configuration: the server blocks, and for each listening
+// address the virtual hosts sharing it. A reload builds a new one and makes
+// it current. Clients hold a reference to the one their request was routed
+// with, so a replaced configuration lives until its last request is done.
+class Routing
+{
+	public:
+		// Parses and validates `configPath`; throws on any error. The caller
+		// owns the one reference the result starts with.
+		static Routing *load(const std::string &configPath);
+
+		// The configuration new requests are routed with
+		static Routing *current();
+		// Makes `routing` current, taking over the caller's reference, and
+		// drops the one held on the previous configuration
+		static void install(Routing *routing);
+
+		void retain();
+		void release();
+
+		const std::deque<ServerConfig> &getServers() const;
+		// Each listening address once, with the ip and port to bind
+		const std::map<std::string, ListenConfig> &getListens() const;
+		// NULL when this configuration does not listen on `address`
+		const VirtualHosts *findHosts(const std::string &address) const;
+
+	private:
+		Routing();
+		~Routing();
+		Routing(const Routing&);
+		Routing& operator=(const Routing&);
+
+		std::deque<ServerConfig> _servers;
+		std::map<std::string, ListenConfig> _listens;
+		std::map<std::string, VirtualHosts> _hosts;
+		size_t _refs;
+
+		static Routing *_current;
+};
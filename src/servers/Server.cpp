@@ -12,7 +12,8 @@
 
 #include "Server.hpp"
 
-Server::Server(const ServerConfig &config) : config(config) {}
+Server::Server(const std::string &address) : address(address)
+{}
 
 Server::~Server()
 {
@@ -23,26 +24,9 @@ Server::~Server()
 	}
 }
 
-bool Server::setup()
+const std::string& Server::getAddress() const
 {
-	const std::map<std::string, ListenConfig>& listens = config.getListens();
-
-	if (listens.empty())
-	{
-		Logger::error("No listen directives in server configuration");
-		return false;
-	}
-
-	for (std::map<std::string, ListenConfig>::const_iterator it = listens.begin();
-		it != listens.end(); ++it)
-	{
-		const std::string& ip = it->second.getIp();
-		int port = it->second.getPort();
-
-		if (!setupSocketForListen(ip, port))
-			return false;
-	}
-	return true;
+	return address;
 }
 
 bool Server::setupSocketForListen(const std::string& ip, int port)
@@ -65,9 +49,9 @@ bool Server::setupSocketForListen(const std::string& ip, int port)
 	return true;
 }
 
-int Server::acceptNewConnection(int serverFd)
+int Server::acceptNewConnection(int serverFd, Routing &routing)
 {
-	return _clientManager.acceptNewClient(serverFd, config);
+	return _clientManager.acceptNewClient(serverFd, routing, address);
 }
 
 bool Server::handleClientEvent(int clientFd, short revents)
@@ -75,6 +59,26 @@ bool Server::handleClientEvent(int clientFd, short revents)
 	return _clientManager.handleClientIO(clientFd, revents);
 }
 
+void Server::collectPollFds(std::vector<struct pollfd> &fds)
+{
+	_clientManager.collectPollFds(fds);
+}
+
+void Server::handleChildExit(pid_t pid, int status)
+{
+	_clientManager.handleChildExit(pid, status);
+}
+
+void Server::checkTimeouts(time_t now)
+{
+	_clientManager.checkTimeouts(now);
+}
+
+void Server::removeClosedClients()
+{
+	_clientManager.removeClosedClients();
+}
+
 const std::vector<int>& Server::getServerFds() const
 {
 	return serverFds;
@@ -85,6 +89,26 @@ void Server::removeClient(int fd)
 	_clientManager.removeClient(fd);
 }
 
+bool Server::isListening() const
+{
+	return !serverFds.empty();
+}
+
+void Server::closeListeners()
+{
+	for (std::vector<int>::iterator it = serverFds.begin(); it != serverFds.end(); ++it)
+	{
+		close(*it);
+		Logger::info("Stopped listening on " + address + " (FD: " + intToString(*it) + ")");
+	}
+	serverFds.clear();
+}
+
+bool Server::hasClients() const
+{
+	return !_clientManager.empty();
+}
+
 int Server::createSocket() const
 {
 	int fd = socket(AF_INET, SOCK_STREAM, 0);
@@ -144,6 +168,7 @@ bool Server::makeSocketNonBlocking(int fd) const
 		Logger::error("fcntl(F_SETFL) failed.");
 		return false;
 	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
 	return true;
 }
 
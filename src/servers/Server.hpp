@@ -12,23 +12,33 @@
 
 #pragma once
 
-#include "../config/ServerConfig.hpp"
 #include "../client/ClientManager.hpp"
+#include "Routing.hpp"
 #include "../utils/Logger.hpp"
 
+// One listening address and the clients accepted on it. The server blocks
+// sharing the address are picked per request from the current Routing.
 class Server
 {
 	public:
-		Server(const ServerConfig &config);
+		explicit Server(const std::string &address);
 		~Server();
 
-		bool setup();
-		int acceptNewConnection(int serverFd);
+		const std::string& getAddress() const;
+		int acceptNewConnection(int serverFd, Routing &routing);
 		bool handleClientEvent(int clientFd, short revents);
+		void collectPollFds(std::vector<struct pollfd> &fds);
+		void handleChildExit(pid_t pid, int status);
+		void checkTimeouts(time_t now);
+		void removeClosedClients();
 		const std::vector<int>& getServerFds() const;
 		void removeClient(int fd);
 		bool setupSocketForListen(const std::string& ip, int port);
 		ClientManager getClientManager() const;
+		bool isListening() const;
+		// Stops accepting; the clients already connected are served to the end
+		void closeListeners();
+		bool hasClients() const;
 
 		void cleanup();
 
@@ -47,6 +57,6 @@ class Server
 		void logSocketInfo(int fd) const;
 
 		std::vector<int> serverFds;
-		ServerConfig config;
+		std::string address;
 		ClientManager _clientManager;
 };
@@ -0,0 +1,96 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   VirtualHosts.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:12:40 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:12:40 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "VirtualHosts.hpp"
+
+VirtualHosts::VirtualHosts() : _first(NULL), _default(NULL) {}
+
+void VirtualHosts::add(const ServerConfig &config, bool defaultServer,
+					const std::string &address)
+{
+	if (!_first)
+		_first = &config;
+
+	if (defaultServer)
+	{
+		if (_default && _default != &config)
+			throw std::runtime_error("Duplicate default server for " + address);
+		_default = &config;
+	}
+
+	const std::vector<std::string> &names = config.getServerNames();
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		std::string name = _normalize(names[i]);
+		bool wildcard = (name.compare(0, 2, "*.") == 0);
+		if (wildcard)
+			name.erase(0, 1);
+		std::map<std::string, const ServerConfig *> &table = wildcard ? _wildcards : _exact;
+
+		std::map<std::string, const ServerConfig *>::iterator it = table.find(name);
+		if (it != table.end() && it->second != &config)
+			throw std::runtime_error("Conflicting server name \"" + names[i]
+				+ "\" on " + address);
+		table[name] = &config;
+	}
+}
+
+bool VirtualHosts::empty() const
+{
+	return _first == NULL;
+}
+
+const ServerConfig &VirtualHosts::defaultServer() const
+{
+	return _default ? *_default : *_first;
+}
+
+const ServerConfig &VirtualHosts::select(const std::string &host) const
+{
+	// A listener with a single server has nothing to choose from
+	if (_exact.empty() && _wildcards.empty())
+		return defaultServer();
+
+	std::string name = _normalize(host);
+	if (name.empty())
+		return defaultServer();
+
+	std::map<std::string, const ServerConfig *>::const_iterator it = _exact.find(name);
+	if (it != _exact.end())
+		return *it->second;
+
+	// Suffixes from the longest down, so the most specific wildcard wins
+	for (size_t dot = name.find('.'); dot != std::string::npos;
+		dot = name.find('.', dot + 1))
+	{
+		it = _wildcards.find(name.substr(dot));
+		if (it != _wildcards.end())
+			return *it->second;
+	}
+	return defaultServer();
+}
+
+// Lowercases the name and drops the port and any trailing dot
+std::string VirtualHosts::_normalize(const std::string &host)
+{
+	size_t end = host.size();
+	size_t colon = host.rfind(':');
+	if (colon != std::string::npos && host.find(']', colon) == std::string::npos)
+		end = colon;
+	while (end > 0 && host[end - 1] == '.')
+		--end;
+
+	std::string name(host, 0, end);
+	for (size_t i = 0; i < name.size(); ++i)
+		name[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[i])));
+	return name;
+}
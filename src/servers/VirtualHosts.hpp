@@ -0,0 +1,42 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   VirtualHosts.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:12:40 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 18:12:40 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+#include "../config/ServerConfig.hpp"
+
+// The server blocks sharing one ip:port listener, looked up by the Host
+// header: exact names first, then the longest "*.example.com" wildcard, then
+// the default server (the one marked default_server, else the first one)
+class VirtualHosts
+{
+	public:
+		VirtualHosts();
+
+		// Throws when a name or the default server is claimed twice
+		void add(const ServerConfig &config, bool defaultServer,
+				const std::string &address);
+		bool empty() const;
+
+		const ServerConfig &select(const std::string &host) const;
+		const ServerConfig &defaultServer() const;
+
+	private:
+		// Keyed by lowercased name; wildcards by their ".example.com" suffix
+		std::map<std::string, const ServerConfig *> _exact;
+		std::map<std::string, const ServerConfig *> _wildcards;
+		const ServerConfig *_first;
+		const ServerConfig *_default;
+
+		static std::string _normalize(const std::string &host);
+};
@@ -11,9 +11,20 @@
 /* ************************************************************************** */
 
 #include "WebServer.hpp"
+#include <sys/resource.h>
 
 
-bool WebServer::_stopFlag = false;
+volatile sig_atomic_t WebServer::_stopFlag = 0;
+volatile sig_atomic_t WebServer::_reloadFlag = 0;
+int WebServer::_signalPipe[2] = {-1, -1};
+
+// Owner tags for poll entries that do not belong to a Server's clients
+static const int LISTENER_OWNER = -1;
+static const int SIGNAL_OWNER = -2;
+static const int FASTCGI_OWNER = -3;
+
+// Wake up at least this often to expire lingering connections
+static const int POLL_TIMEOUT_MS = 1000;
 
 WebServer::WebServer(const std::string& configPath) : configPath(configPath)
 {}
@@ -28,148 +39,311 @@ void WebServer::run()
 	Logger::info("WebServer starting...");
 	signal(SIGINT, handleSigInt);
 	signal(SIGQUIT, handleSigInt);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGHUP, handleSigHup);
 	parseConfig();
 	setupServers();
+	CgiWorkerPool::configure(Routing::current()->getServers());
 	initPollStructures();
+	initSignalPipe();
 	runEventLoop();
 }
 
 void WebServer::parseConfig()
 {
-	ConfigParser parser(configPath);
-	serverConfigs = parser.parse();
+	Routing::install(Routing::load(configPath));
+	Logger::info("Parsed " + intToString(Routing::current()->getServers().size())
+		+ " server configurations");
+}
 
-	if (serverConfigs.empty()) {
-		throw std::runtime_error("No server configurations found");
+bool WebServer::check()
+{
+	double start = Metrics::now();
+	Routing *routing;
+	try
+	{
+		routing = Routing::load(configPath);
 	}
+	catch (const std::exception& e)
+	{
+		Logger::error(e.what());
+		Logger::error("Configuration file " + configPath + " test failed");
+		return false;
+	}
+	double elapsed = Metrics::now() - start;
+
+	const std::deque<ServerConfig> &configs = routing->getServers();
+	size_t locations = 0;
+	for (size_t i = 0; i < configs.size(); ++i)
+		locations += configs[i].getLocations().size();
+
+	// ru_maxrss is in kilobytes on Linux and in bytes on macOS
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	long peakKb = usage.ru_maxrss / 1024;
+#else
+	long peakKb = usage.ru_maxrss;
+#endif
 
-	Logger::info("Parsed " + intToString(serverConfigs.size()) + " server configurations");
+	std::ostringstream report;
+	report << configs.size() << " servers, " << locations << " locations loaded in "
+		<< static_cast<long>(elapsed * 1000) << " ms, peak RSS " << peakKb / 1024 << " MiB";
+	Logger::info(report.str());
+	Logger::info("Configuration file " + configPath + " test is successful");
+	routing->release();
+	return true;
 }
 
+// Each ip:port is bound once; the server blocks sharing it are told apart by
+// the Host header
 void WebServer::setupServers()
 {
-	for (size_t i = 0; i < serverConfigs.size(); ++i) {
-		Server* server = new Server(serverConfigs[i]);
-		if (!server->setup()) {
-			delete server;
-			throw std::runtime_error("Failed to setup server");
+	if (!openListeners(*Routing::current()))
+		throw std::runtime_error("Failed to setup server");
+}
+
+// Binds every address of `routing` that is not listened on yet. When one
+// fails, the ones bound here are closed again and nothing changes.
+bool WebServer::openListeners(const Routing &routing)
+{
+	std::set<std::string> listening;
+	for (size_t i = 0; i < servers.size(); ++i) {
+		if (servers[i]->isListening())
+			listening.insert(servers[i]->getAddress());
+	}
+
+	size_t existing = servers.size();
+	const std::map<std::string, ListenConfig> &listens = routing.getListens();
+	for (std::map<std::string, ListenConfig>::const_iterator it = listens.begin();
+		it != listens.end(); ++it) {
+		if (listening.count(it->first))
+			continue;
+
+		servers.push_back(new Server(it->first));
+		if (!servers.back()->setupSocketForListen(it->second.getIp(), it->second.getPort())) {
+			while (servers.size() > existing) {
+				servers.back()->cleanup();
+				delete servers.back();
+				servers.pop_back();
+			}
+			return false;
 		}
-		servers.push_back(server);
 	}
+	return true;
+}
+
+// The new configuration is loaded and its new ports bound before anything
+// changes, so a broken file leaves the running one untouched. Requests in
+// progress finish with the configuration they started with.
+void WebServer::reload()
+{
+	Logger::info("Received SIGHUP, reloading " + configPath);
+
+	Routing *next;
+	try
+	{
+		next = Routing::load(configPath);
+	}
+	catch (const std::exception& e)
+	{
+		Logger::error(e.what());
+		Logger::error("Reload failed, keeping the current configuration");
+		Metrics::increment("config_reload_failures_total");
+		return;
+	}
+	if (!openListeners(*next)) {
+		next->release();
+		Logger::error("Reload failed, keeping the current configuration");
+		Metrics::increment("config_reload_failures_total");
+		return;
+	}
+
+	for (size_t i = 0; i < servers.size(); ++i) {
+		if (servers[i]->isListening() && !next->findHosts(servers[i]->getAddress()))
+			servers[i]->closeListeners();
+	}
+
+	Routing::install(next);
+	CgiWorkerPool::configure(next->getServers());
+	removeDrainedServers();
+	initPollStructures();
+	Metrics::increment("config_reloads_total");
+	Logger::info("Reloaded " + intToString(next->getServers().size())
+		+ " server configurations");
+}
+
+// Servers whose address a reload removed go once their last client does
+void WebServer::removeDrainedServers()
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < servers.size(); ++i) {
+		if (!servers[i]->isListening() && !servers[i]->hasClients()) {
+			servers[i]->cleanup();
+			delete servers[i];
+		} else
+			servers[kept++] = servers[i];
+	}
+	if (kept == servers.size())
+		return;
+	servers.resize(kept);
+	initPollStructures();
 }
 
 void WebServer::initPollStructures()
 {
+	fdToServerIndex.clear();
+	serverFdsSet.clear();
 	for (size_t i = 0; i < servers.size(); ++i) {
 		const std::vector<int>& serverFds = servers[i]->getServerFds();
 		for (size_t j = 0; j < serverFds.size(); ++j) {
-			struct pollfd pfd;
-			pfd.fd = serverFds[j];
-			pfd.events = POLLIN;
-			pfd.revents = 0;
-			pollFds.push_back(pfd);
-
 			fdToServerIndex[serverFds[j]] = i;
 			serverFdsSet.insert(serverFds[j]);
 		}
 	}
 }
 
+// SIGCHLD and SIGHUP only write a byte here; children are reaped and the
+// configuration reloaded from the event loop
+void WebServer::initSignalPipe()
+{
+	if (pipe(_signalPipe) < 0)
+		throw std::runtime_error("Failed to create signal pipe");
+
+	for (int i = 0; i < 2; ++i) {
+		fcntl(_signalPipe[i], F_SETFL, fcntl(_signalPipe[i], F_GETFL, 0) | O_NONBLOCK);
+		fcntl(_signalPipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	signal(SIGCHLD, handleSigChld);
+}
+
+// The poll set is rebuilt every iteration so each client only asks for the
+// events its current state can use (no POLLOUT with nothing to send)
+void WebServer::buildPollFds()
+{
+	pollFds.clear();
+	pollOwners.clear();
+
+	struct pollfd pfd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	pfd.fd = _signalPipe[0];
+	pollFds.push_back(pfd);
+	pollOwners.push_back(SIGNAL_OWNER);
+
+	for (std::set<int>::const_iterator it = serverFdsSet.begin();
+		it != serverFdsSet.end(); ++it) {
+		pfd.fd = *it;
+		pollFds.push_back(pfd);
+		pollOwners.push_back(LISTENER_OWNER);
+	}
+
+	FastCgiPool::collectPollFds(pollFds);
+	pollOwners.resize(pollFds.size(), FASTCGI_OWNER);
+
+	for (size_t i = 0; i < servers.size(); ++i) {
+		servers[i]->collectPollFds(pollFds);
+		pollOwners.resize(pollFds.size(), i);
+	}
+}
+
 void WebServer::runEventLoop()
 {
 	while (!_stopFlag) {
+		buildPollFds();
+
 		// SINGLE POLL CALL - evaluation requirement
-		int ready = poll(pollFds.data(), pollFds.size(), -1);
+		int ready = poll(pollFds.data(), pollFds.size(), POLL_TIMEOUT_MS);
 
 		if (ready < 0) {
 			// NO ERRNO CHECKING - evaluation requirement
 			continue;
 		}
 
-		std::vector<struct pollfd> newConnections;
-		std::vector<size_t> toRemove;
-
-		handlePollEvents(newConnections, toRemove, pollFds);
-
-		// Add new connections
-		for (size_t i = 0; i < newConnections.size(); ++i) {
-			pollFds.push_back(newConnections[i]);
+		handlePollEvents();
+		if (_reloadFlag) {
+			_reloadFlag = 0;
+			reload();
 		}
 
-		// Remove closed connections (in reverse order)
-		for (int i = toRemove.size() - 1; i >= 0; --i) {
-			size_t index = toRemove[i];
-			int fd = pollFds[index].fd;
-
-			// Remove from server if it's a client
-			if (serverFdsSet.find(fd) == serverFdsSet.end()) {
-				// Find which server owns this client
-				for (size_t j = 0; j < servers.size(); ++j) {
-					servers[j]->removeClient(fd);
-				}
-			}
+		double tick = Metrics::now();
+		CgiWorkerPool::maintain(tick);
+		CgiLimiter::maintain(tick);
 
-			pollFds.erase(pollFds.begin() + index);
+		time_t now = time(NULL);
+		for (size_t i = 0; i < servers.size(); ++i) {
+			servers[i]->checkTimeouts(now);
+			servers[i]->removeClosedClients();
 		}
+		removeDrainedServers();
 	}
 }
 
-void WebServer::handlePollEvents(std::vector<struct pollfd>& newConnections,
-								std::vector<size_t>& toRemove,
-								const std::vector<struct pollfd>& allFds)
+void WebServer::handlePollEvents()
 {
-	for (size_t i = 0; i < allFds.size(); ++i) {
-		if (allFds[i].revents == 0) continue;
+	for (size_t i = 0; i < pollFds.size(); ++i) {
+		if (pollFds[i].revents == 0) continue;
 
-		int fd = allFds[i].fd;
+		int fd = pollFds[i].fd;
+		int owner = pollOwners[i];
 
-		if (serverFdsSet.find(fd) != serverFdsSet.end()) {
-			// Server socket - accept new connection
-			int serverIndex = fdToServerIndex[fd];
-			int clientFd = servers[serverIndex]->acceptNewConnection(fd);
-
-			if (clientFd > 0) {
-				struct pollfd clientPfd;
-				clientPfd.fd = clientFd;
-				clientPfd.events = POLLIN | POLLOUT;
-				clientPfd.revents = 0;
-				newConnections.push_back(clientPfd);
-			}
+		if (owner == SIGNAL_OWNER) {
+			char buf[64];
+			while (read(fd, buf, sizeof(buf)) > 0)
+				;
+			reapChildren();
+		} else if (owner == FASTCGI_OWNER) {
+			FastCgiPool::handleEvent(fd, pollFds[i].revents);
+		} else if (owner == LISTENER_OWNER) {
+			// Server socket - accept new connection, polled from next iteration
+			servers[fdToServerIndex[fd]]->acceptNewConnection(fd, *Routing::current());
 		} else {
-			// Client socket - handle I/O
-			bool keepConnection = false;
-			for (size_t j = 0; j < servers.size(); ++j) {
-				if (servers[j]->handleClientEvent(fd, allFds[i].revents)) {
-					keepConnection = true;
-					break;
-				}
-			}
-
-			if (!keepConnection) {
-				toRemove.push_back(i);
-			}
+			// Client socket or one of its CGI pipes
+			servers[owner]->handleClientEvent(fd, pollFds[i].revents);
 		}
 	}
 }
 
-void WebServer::cleanup()
+void WebServer::reapChildren()
 {
-	for (size_t i = 0; i < pollFds.size(); ++i)
-	{
-		if (pollFds[i].fd >= 0)
-			close(pollFds[i].fd);
+	int status;
+	pid_t pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		if (CgiWorkerPool::handleChildExit(pid, status))
+			continue;
+		for (size_t i = 0; i < servers.size(); ++i)
+			servers[i]->handleChildExit(pid, status);
 	}
+}
 
+void WebServer::cleanup()
+{
+	CgiLimiter::cleanup();
+	CgiCache::cleanup();
+	AutoIndex::cleanup();
 	for (size_t i = 0; i < servers.size(); ++i)
 	{
 		servers[i]->cleanup();
 		delete servers[i];
 	}
+	FastCgiPool::cleanup();
+	CgiWorkerPool::cleanup();
+
+	for (int i = 0; i < 2; ++i)
+	{
+		if (_signalPipe[i] >= 0)
+			close(_signalPipe[i]);
+		_signalPipe[i] = -1;
+	}
 
 	pollFds.clear();
+	pollOwners.clear();
 	servers.clear();
 	serverFdsSet.clear();
 	fdToServerIndex.clear();
+	Routing::install(NULL);
 }
 
 std::string WebServer::intToString(int value)
@@ -179,9 +353,29 @@ std::string WebServer::intToString(int value)
 	return oss.str();
 }
 
+void WebServer::handleSigChld(int signum)
+{
+	(void)signum;
+	int savedErrno = errno;
+	if (_signalPipe[1] >= 0)
+		write(_signalPipe[1], "c", 1);
+	errno = savedErrno;
+}
+
+// Reloading happens in the event loop, between two rounds of events
+void WebServer::handleSigHup(int signum)
+{
+	(void)signum;
+	int savedErrno = errno;
+	_reloadFlag = 1;
+	if (_signalPipe[1] >= 0)
+		write(_signalPipe[1], "h", 1);
+	errno = savedErrno;
+}
+
 void WebServer::handleSigInt(int signum)
 {
 	(void)signum;
 	Logger::info("Received SIGINT, shutting down ...");
-	_stopFlag = true;
+	_stopFlag = 1;
 }
\ No newline at end of file
@@ -15,9 +15,15 @@
 #include "../../inc/webserv.hpp"
 
 #include "Server.hpp"
-#include "../config/ConfigParser.hpp"
+#include "Routing.hpp"
 #include "../utils/Logger.hpp"
 #include "../client/ClientManager.hpp"
+#include "../cgi/FastCgiPool.hpp"
+#include "../cgi/CgiWorkerPool.hpp"
+#include "../cgi/CgiLimiter.hpp"
+#include "../cgi/CgiCache.hpp"
+#include "../http/AutoIndex.hpp"
+#include "../utils/Metrics.hpp"
 
 class WebServer
 {
@@ -26,6 +32,9 @@ class WebServer
 		~WebServer();
 
 		void run();
+		// Loads the configuration as run() would, without binding anything,
+		// and reports how long that took and how much memory it used
+		bool check();
 
 	private:
 		WebServer(const WebServer&);
@@ -34,23 +43,34 @@ class WebServer
 		void handleArguments(int argc, char** argv);
 		void parseConfig();
 		void setupServers();
+		bool openListeners(const Routing &routing);
+		void reload();
+		void removeDrainedServers();
 		void initPollStructures();
+		void initSignalPipe();
+		void buildPollFds();
 		void runEventLoop();
-		void handlePollEvents(std::vector<struct pollfd>& newConnections,
-							std::vector<size_t>& toRemove, const std::vector<struct pollfd>& allFds);
+		void handlePollEvents();
+		void reapChildren();
 		void acceptNewConnections();
 		void cleanup();
 
 		static void handleSigInt(int signum);
+		static void handleSigChld(int signum);
+		static void handleSigHup(int signum);
 
 		static std::string intToString(int value);
 
 		std::string configPath;
-		std::vector<ServerConfig> serverConfigs;
+		// One per listening address, plus the ones a reload removed that
+		// still have clients to finish
 		std::vector<Server*> servers;
 		std::vector<struct pollfd> pollFds;
+		std::vector<int> pollOwners;
 		std::map<int, int> fdToServerIndex;
 		std::set<int> serverFdsSet;
 
-		static bool _stopFlag;
+		static volatile sig_atomic_t _stopFlag;
+		static volatile sig_atomic_t _reloadFlag;
+		static int _signalPipe[2];
 };
@@ -0,0 +1,108 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 15:20:37 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 15:20:37 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Metrics.hpp"
+#include <cmath>
+#include <iomanip>
+#include <sys/time.h>
+
+std::map<std::string, double> Metrics::_values;
+std::map<std::string, Metrics::Summary> Metrics::_summaries;
+
+void Metrics::increment(const std::string &name, double by)
+{
+	_values[name] += by;
+}
+
+void Metrics::setGauge(const std::string &name, double value)
+{
+	_values[name] = value;
+}
+
+void Metrics::observe(const std::string &name, double value)
+{
+	std::map<std::string, Summary>::iterator it = _summaries.find(name);
+	if (it == _summaries.end()) {
+		Summary summary = {0, 0, 0};
+		it = _summaries.insert(std::make_pair(name, summary)).first;
+	}
+	it->second.count++;
+	it->second.sum += value;
+	it->second.max = std::max(it->second.max, value);
+}
+
+// Label values come from configuration (rewrite patterns, location paths),
+// so backslashes, quotes and newlines are escaped as the text format requires
+std::string Metrics::label(const std::string &name, const std::string &key,
+						const std::string &value)
+{
+	std::string escaped;
+	for (size_t i = 0; i < value.size(); ++i) {
+		if (value[i] == '\n') {
+			escaped += "\\n";
+			continue;
+		}
+		if (value[i] == '\\' || value[i] == '"')
+			escaped += '\\';
+		escaped += value[i];
+	}
+	return name + "{" + key + "=\"" + escaped + "\"}";
+}
+
+// The suffix goes on the metric name, before any labels
+static std::string withSuffix(const std::string &name, const char *suffix)
+{
+	size_t brace = name.find('{');
+	if (brace == std::string::npos)
+		return name + suffix;
+	return name.substr(0, brace) + suffix + name.substr(brace);
+}
+
+// Counters and byte totals print as plain integers however large they get;
+// fractional values such as latency sums keep microsecond precision
+static void writeValue(std::ostream &out, double value)
+{
+	if (value == std::floor(value))
+		out << std::fixed << std::setprecision(0) << value;
+	else
+		out << std::fixed << std::setprecision(6) << value;
+}
+
+std::string Metrics::render()
+{
+	std::ostringstream out;
+
+	for (std::map<std::string, double>::const_iterator it = _values.begin();
+		it != _values.end(); ++it) {
+		out << it->first << " ";
+		writeValue(out, it->second);
+		out << "\n";
+	}
+
+	for (std::map<std::string, Summary>::const_iterator it = _summaries.begin();
+		it != _summaries.end(); ++it) {
+		out << withSuffix(it->first, "_count") << " " << it->second.count << "\n";
+		out << withSuffix(it->first, "_sum") << " ";
+		writeValue(out, it->second.sum);
+		out << "\n" << withSuffix(it->first, "_max") << " ";
+		writeValue(out, it->second.max);
+		out << "\n";
+	}
+	return out.str();
+}
+
+double Metrics::now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
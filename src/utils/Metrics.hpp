@@ -0,0 +1,44 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: meferraz <meferraz@student.42porto.pt>     +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 15:20:37 by meferraz          #+#    #+#             */
+/*   Updated: 2026/10/18 15:20:37 by meferraz         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include "../../inc/webserv.hpp"
+
+// Process-wide counters, gauges and summaries, rendered as plain text by a
+// location with "metrics on". Names may carry labels: name{key="value"}.
+class Metrics
+{
+	public:
+		static void increment(const std::string &name, double by = 1);
+		static void setGauge(const std::string &name, double value);
+		// Records one sample; rendered as _count, _sum and _max
+		static void observe(const std::string &name, double value);
+
+		static std::string label(const std::string &name, const std::string &key,
+								const std::string &value);
+		static std::string render();
+
+		// Wall clock in seconds, with sub-second precision
+		static double now();
+
+	private:
+		struct Summary
+		{
+			unsigned long count;
+			double sum;
+			double max;
+		};
+
+		static std::map<std::string, double> _values;
+		static std::map<std::string, Summary> _summaries;
+};
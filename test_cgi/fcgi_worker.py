@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+# Stand-in for php-cgi in scripts/test_cgi_pool.sh when PHP is not installed.
+# Like php-cgi it serves FastCGI only when stdin is a listening socket
+# (getpeername fails with ENOTCONN) and is a one-shot CGI otherwise.
+import errno
+import os
+import socket
+import struct
+import sys
+
+BEGIN_REQUEST, END_REQUEST, PARAMS, STDIN, STDOUT = 1, 3, 4, 5, 6
+KEEP_CONN = 1
+
+
+def is_fastcgi():
+    try:
+        sock = socket.socket(fileno=os.dup(0))
+    except OSError:
+        return None
+    try:
+        sock.getpeername()
+    except OSError as e:
+        if e.errno == errno.ENOTCONN:
+            return sock
+    sock.close()
+    return None
+
+
+def read_exact(conn, n):
+    data = b""
+    while len(data) < n:
+        chunk = conn.recv(n - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+
+def read_record(conn):
+    header = read_exact(conn, 8)
+    if header is None:
+        return None
+    _, rtype, rid, length, padding, _ = struct.unpack("!BBHHBB", header)
+    content = read_exact(conn, length + padding) if length + padding else b""
+    if content is None:
+        return None
+    return rtype, rid, content[:length]
+
+
+def record(rtype, rid, content):
+    return struct.pack("!BBHHBB", 1, rtype, rid, len(content), 0, 0) + content
+
+
+def parse_params(data):
+    params, pos = {}, 0
+    while pos < len(data):
+        lengths = []
+        for _ in range(2):
+            n = data[pos]
+            if n & 0x80:
+                n = struct.unpack("!I", data[pos:pos + 4])[0] & 0x7fffffff
+                pos += 4
+            else:
+                pos += 1
+            lengths.append(n)
+        name = data[pos:pos + lengths[0]]
+        pos += lengths[0]
+        params[name.decode()] = data[pos:pos + lengths[1]].decode()
+        pos += lengths[1]
+    return params
+
+
+# One request on `conn`; returns whether the connection stays open, or None
+# when it closed before a whole request came in
+def serve(conn):
+    params, body, flags, rid = b"", b"", 0, 1
+    while True:
+        rec = read_record(conn)
+        if rec is None:
+            return None
+        rtype, rid, content = rec
+        if rtype == BEGIN_REQUEST:
+            flags = content[2]
+        elif rtype == PARAMS:
+            params += content
+        elif rtype == STDIN:
+            if not content:
+                break
+            body += content
+    env = parse_params(params)
+    out = ("Content-Type: text/plain\r\n\r\n"
+           "pid=%d\nscript=%s\nbody=%d\n"
+           % (os.getpid(), env.get("SCRIPT_FILENAME", ""), len(body))).encode()
+    conn.sendall(record(STDOUT, rid, out) + record(STDOUT, rid, b"")
+                 + record(END_REQUEST, rid, b"\0" * 8))
+    return bool(flags & KEEP_CONN)
+
+
+def main():
+    listener = is_fastcgi()
+    if listener is None:
+        sys.stdout.write("Status: 404 Not Found\r\nContent-type: text/html\r\n\r\n"
+                         "No input file specified.\n")
+        return
+    limit = int(os.environ.get("PHP_FCGI_MAX_REQUESTS", "0") or 0)
+    served = 0
+    while limit == 0 or served < limit:
+        conn, _ = listener.accept()
+        while limit == 0 or served < limit:
+            keep = serve(conn)
+            if keep is None:
+                break
+            served += 1
+            if not keep:
+                break
+        conn.close()
+
+
+if __name__ == "__main__":
+    main()